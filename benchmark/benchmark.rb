@@ -52,6 +52,18 @@ def measure_json_dump_performance(json_size)
   }
 end
 
+def measure_json_parse_allocations(cache_keys)
+  GC.start
+  before = ObjectSpace.count_objects[:T_STRING]
+  GC.disable
+  timer = Chrono::Timer.new
+  JSON.parse($json, cache_keys: cache_keys)
+  elapsed = timer.elapsed
+  strings = ObjectSpace.count_objects[:T_STRING] - before
+  GC.enable
+  { time: elapsed, strings: strings }
+end
+
 result = measure_json_dump_performance(json_size)
 
 puts "--- Load (JSON.parse_lazy) ---"
@@ -68,3 +80,32 @@ puts "--- Dump (1 second sustained) ---"
 puts "Performance        : #{result[:dump][:gbps].round(2)} GBps"
 puts "Ops/sec            : #{result[:dump][:ops_per_sec].round(2)}"
 puts "Elapsed            : #{result[:dump][:time].round(6)} seconds"
+
+if Object.const_defined?(:ObjectSpace)
+  [false, true].each do |cache_keys|
+    alloc = measure_json_parse_allocations(cache_keys)
+    puts "--- JSON.parse (cache_keys: #{cache_keys}) ---"
+    puts "Elapsed            : #{alloc[:time].round(6)} seconds"
+    puts "Throughput         : #{((json_size.to_f / alloc[:time]) / 1_000_000_000).round(2)} GBps"
+    puts "Strings allocated  : #{alloc[:strings]}"
+  end
+end
+
+def measure_json_dump_numbers
+  data = (0...100_000).map { |i| [i, i * 1.5, -i, i * 1000] }
+  ops = 0
+  bytes = 0
+  timer = Chrono::Timer.new
+  while timer.elapsed < 1.0
+    bytes += JSON.dump(data).bytesize
+    ops += 1
+  end
+  elapsed = timer.elapsed
+  { gbps: (bytes.to_f / elapsed) / 1_000_000_000, ops_per_sec: ops.to_f / elapsed, time: elapsed }
+end
+
+numbers = measure_json_dump_numbers
+puts "--- Dump, number-heavy (1 second sustained) ---"
+puts "Performance        : #{numbers[:gbps].round(2)} GBps"
+puts "Ops/sec            : #{numbers[:ops_per_sec].round(2)}"
+puts "Elapsed            : #{numbers[:time].round(6)} seconds"
@@ -0,0 +1,139 @@
+# Benchmark suite over the standard simdjson corpora.
+#
+#   mruby benchmark/suite.rb <corpus_dir> [results.json] [seconds_per_case] [implementations]
+#
+# Runs JSON.parse, JSON.parse_lazy, JSON.load_file, Document#into, JSON.dump,
+# JSON.valid_utf8?, JSON.minify, JSON.reformat, JSON.parse_each (NDJSON) and a synthetic
+# deeply nested document, and prints one JSON document with MB/s, ops/s and
+# allocations per case plus the peak RSS of the process. `rake bench`
+# fetches the corpora (deps/simdjson/jsonexamples) and runs this file.
+#
+# implementations is "active" (the default), "all" for every SIMD kernel
+# this CPU supports, or a comma-separated list such as "haswell,fallback";
+# each case is then repeated per kernel.
+
+corpus_dir = ARGV[0] || "deps/simdjson/jsonexamples"
+out_path   = ARGV[1]
+$seconds   = (ARGV[2] || "1.0").to_f
+impls      = case ARGV[3]
+             when nil, "", "active" then [JSON.implementation]
+             when "all"             then JSON.implementations
+             else ARGV[3].split(",")
+             end
+
+CORPORA = %w[twitter.json citm_catalog.json canada.json gsoc-2018.json]
+
+def sustained(bytes)
+  ops = 0
+  total = 0
+  timer = Chrono::Timer.new
+  while timer.elapsed < $seconds
+    b = yield
+    total += (b.is_a?(Integer) ? b : bytes)
+    ops += 1
+  end
+  elapsed = timer.elapsed
+  { "ops_per_sec" => (ops / elapsed).round(2), "mb_per_sec" => ((total / elapsed) / 1_000_000).round(2) }
+end
+
+# Objects allocated by one run, or nil when ObjectSpace is not compiled in.
+def allocations
+  return nil unless Object.const_defined?(:ObjectSpace)
+  GC.start
+  GC.disable
+  before = ObjectSpace.count_objects
+  yield
+  after = ObjectSpace.count_objects
+  GC.enable
+  (after[:TOTAL] - after[:FREE]) - (before[:TOTAL] - before[:FREE])
+end
+
+# VmHWM from /proc, nil where that does not exist.
+def peak_rss_kb
+  return nil unless File.exist?("/proc/self/status")
+  line = File.read("/proc/self/status").split("\n").find { |l| l.start_with?("VmHWM:") }
+  line && line.split[1].to_i
+end
+
+class BenchUser
+  native_ext_type :@screen_name,     String
+  native_ext_type :@followers_count, Integer
+end
+
+class BenchStatus
+  native_ext_type :@id,   Integer
+  native_ext_type :@text, String
+  native_ext_type :@user, BenchUser
+end
+
+class BenchTimeline
+  native_ext_type :@statuses, [BenchStatus]
+end
+
+$results = []
+$skipped = []
+
+def record(corpus, op, bytes, &blk)
+  allocs = allocations(&blk)
+  res = sustained(bytes, &blk)
+  $results << { "implementation" => JSON.implementation, "corpus" => corpus, "op" => op, "bytes" => bytes }.merge(res).merge("allocations" => allocs)
+end
+
+def run_suite(corpus_dir)
+  CORPORA.each do |name|
+    path = "#{corpus_dir}/#{name}"
+    unless File.exist?(path)
+      $skipped << name
+      next
+    end
+    json = File.read(path)
+    bytes = json.bytesize
+    parsed = JSON.parse(json)
+    dumped = JSON.dump(parsed).bytesize
+
+    record(name, "parse", bytes)      { JSON.parse(json) }
+    record(name, "parse_lazy", bytes) { JSON.parse_lazy(json).at_pointer("") }
+    record(name, "load_file", bytes)  { JSON.load_file(path) }
+    record(name, "dump", dumped)      { JSON.dump(parsed).bytesize }
+    record(name, "valid_utf8", bytes) { JSON.valid_utf8?(json) }
+    record(name, "minify", bytes)     { JSON.minify(json) }
+    record(name, "reformat", bytes)   { JSON.reformat(json) }
+    record(name, "reformat_compact", bytes) { JSON.reformat(json, indent: 0) }
+    if name == "twitter.json"
+      record(name, "into", bytes) { JSON.parse_lazy(json).into(BenchTimeline.new) }
+    end
+  end
+
+  twitter = "#{corpus_dir}/twitter.json"
+  if File.exist?(twitter)
+    # NDJSON log sample: the twitter statuses, one per line, repeated to ~4 MB.
+    lines = JSON.parse(File.read(twitter))["statuses"].map { |s| JSON.dump(s) }
+    ndjson = ""
+    ndjson << lines.join("\n") << "\n" while ndjson.bytesize < 4_000_000
+    record("twitter-statuses.ndjson", "parse_each", ndjson.bytesize) { JSON.parse_each(ndjson) { |_| } }
+  end
+
+  # Deep nesting around one big array: per-level pre-sizing would re-walk
+  # the array once per enclosing level on the OnDemand path.
+  inner = "[" + (["{\"id\":1,\"tags\":[\"a\",\"b\"]}"] * 50_000).join(",") + "]"
+  deep = ("{\"a\":[" * 64) + inner + ("]}" * 64)
+  record("deep-wrapped-array", "parse_lazy", deep.bytesize) { JSON.parse_lazy(deep).at_pointer("") }
+  record("deep-wrapped-array", "parse", deep.bytesize) { JSON.parse(deep) }
+end
+
+impls.each do |impl|
+  JSON.implementation = impl
+  run_suite(corpus_dir)
+end
+
+report = {
+  "simd_implementation" => JSON::SIMD_IMPLEMENTATION,
+  "implementations" => impls,
+  "seconds_per_case" => $seconds,
+  "results" => $results,
+  "skipped" => $skipped.uniq,
+  "peak_rss_kb" => peak_rss_kb
+}
+out = JSON.dump(report)
+puts out
+File.open(out_path, "w") { |f| f.write(out) } if out_path
@@ -0,0 +1,28 @@
+# Scaling benchmark for JSON.parse / JSON.dump with threads:.
+# Builds one large top-level array and reports throughput at 1, 2, 4 and 8 threads.
+
+records = (0...500_000).map do |i|
+  { "id" => i, "name" => "item#{i}", "price" => i * 0.25, "tags" => ["a", "b", "c"], "active" => i.even? }
+end
+json = JSON.dump(records)
+puts "Payload            : #{(json.bytesize / 1_000_000.0).round(1)} MB, #{records.size} records"
+
+def sustained(seconds = 1.0)
+  ops = 0
+  bytes = 0
+  timer = Chrono::Timer.new
+  while timer.elapsed < seconds
+    bytes += yield
+    ops += 1
+  end
+  elapsed = timer.elapsed
+  { gbps: (bytes.to_f / elapsed) / 1_000_000_000, ops_per_sec: ops.to_f / elapsed }
+end
+
+[1, 2, 4, 8].each do |threads|
+  parse = sustained { JSON.parse(json, threads: threads); json.bytesize }
+  dump  = sustained { JSON.dump(records, threads: threads).bytesize }
+  puts "--- threads: #{threads} ---"
+  puts "Parse              : #{parse[:gbps].round(2)} GBps (#{parse[:ops_per_sec].round(2)} ops/sec)"
+  puts "Dump               : #{dump[:gbps].round(2)} GBps (#{dump[:ops_per_sec].round(2)} ops/sec)"
+end
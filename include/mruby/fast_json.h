@@ -7,62 +7,82 @@
 
 MRB_BEGIN_DECL
 
-#define E_JSON_PARSER_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "ParserError"))
-#define E_JSON_TAPE_ERROR               (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "TapeError"))
-#define E_JSON_STRING_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "StringError"))
-#define E_JSON_UNCLOSED_STRING_ERROR    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UnclosedStringError"))
-#define E_JSON_MEMALLOC_ERROR           (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "MemoryAllocationError"))
-#define E_JSON_DEPTH_ERROR              (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "DepthError"))
-#define E_JSON_UTF8_ERROR               (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UTF8Error"))
-#define E_JSON_NUMBER_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "NumberError"))
-#define E_JSON_CAPACITY_ERROR           (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "CapacityError"))
-#define E_JSON_INCORRECT_TYPE_ERROR     (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "IncorrectTypeError"))
-#define E_JSON_UNSUPPORTED_ARCHITECTURE_ERROR (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UnsupportedArchitectureError"))
-#define E_JSON_EMPTY_INPUT_ERROR        (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "EmptyInputError"))
-#define E_JSON_NO_SUCH_FIELD_ERROR      (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "NoSuchFieldError"))
-#define E_JSON_UNEXPECTED_ERROR         (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UnexpectedError"))
-#define E_JSON_T_ATOM_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "TAtomError"))
-#define E_JSON_F_ATOM_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "FAtomError"))
-#define E_JSON_N_ATOM_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "NAtomError"))
-
-#define E_JSON_BIGINT_ERROR             (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "BigIntError"))
-#define E_JSON_UNINITIALIZED_ERROR      (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UninitializedError"))
-
-#define E_JSON_UNESCAPED_CHARS_ERROR    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "UnescapedCharsError"))
-
-#define E_JSON_NUMBER_OUT_OF_RANGE_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "NumberOutOfRangeError"))
-
-#define E_JSON_INDEX_OUT_OF_BOUNDS_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "IndexOutOfBoundsError"))
-
-#define E_JSON_IO_ERROR                 (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "IOError"))
-#define E_JSON_INVALID_JSON_POINTER_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "InvalidJSONPointerError"))
-
-#define E_JSON_INVALID_URI_FRAGMENT_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "InvalidURIFragmentError"))
-
-#define E_JSON_PARSER_IN_USE_ERROR      (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "ParserInUseError"))
-
-#define E_JSON_OUT_OF_ORDER_ITERATION_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "OutOfOrderIterationError"))
-
-#define E_JSON_INSUFFICIENT_PADDING_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "InsufficientPaddingError"))
-
-#define E_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "IncompleteArrayOrObjectError"))
-
-#define E_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR \
-    (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "ScalarDocumentAsValueError"))
-
-#define E_JSON_OUT_OF_BOUNDS_ERROR      (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "OutOfBoundsError"))
-
-#define E_JSON_TRAILING_CONTENT_ERROR  (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "TrailingContentError"))
-
-#define E_JSON_OUT_OF_CAPACITY_ERROR   (mrb_class_get_under(mrb, mrb_module_get(mrb, "JSON"), "OutOfCapacityError"))
+/* Error classes under JSON, resolved once per mrb_state at gem init. */
+enum mrb_json_error {
+  MRB_JSON_PARSER_ERROR,
+  MRB_JSON_TAPE_ERROR,
+  MRB_JSON_STRING_ERROR,
+  MRB_JSON_UNCLOSED_STRING_ERROR,
+  MRB_JSON_MEMALLOC_ERROR,
+  MRB_JSON_DEPTH_ERROR,
+  MRB_JSON_UTF8_ERROR,
+  MRB_JSON_NUMBER_ERROR,
+  MRB_JSON_CAPACITY_ERROR,
+  MRB_JSON_INCORRECT_TYPE_ERROR,
+  MRB_JSON_UNSUPPORTED_ARCHITECTURE_ERROR,
+  MRB_JSON_EMPTY_INPUT_ERROR,
+  MRB_JSON_NO_SUCH_FIELD_ERROR,
+  MRB_JSON_UNEXPECTED_ERROR,
+  MRB_JSON_T_ATOM_ERROR,
+  MRB_JSON_F_ATOM_ERROR,
+  MRB_JSON_N_ATOM_ERROR,
+  MRB_JSON_BIGINT_ERROR,
+  MRB_JSON_UNINITIALIZED_ERROR,
+  MRB_JSON_UNESCAPED_CHARS_ERROR,
+  MRB_JSON_NUMBER_OUT_OF_RANGE_ERROR,
+  MRB_JSON_INDEX_OUT_OF_BOUNDS_ERROR,
+  MRB_JSON_IO_ERROR,
+  MRB_JSON_INVALID_JSON_POINTER_ERROR,
+  MRB_JSON_INVALID_URI_FRAGMENT_ERROR,
+  MRB_JSON_PARSER_IN_USE_ERROR,
+  MRB_JSON_OUT_OF_ORDER_ITERATION_ERROR,
+  MRB_JSON_INSUFFICIENT_PADDING_ERROR,
+  MRB_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR,
+  MRB_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR,
+  MRB_JSON_OUT_OF_BOUNDS_ERROR,
+  MRB_JSON_TRAILING_CONTENT_ERROR,
+  MRB_JSON_OUT_OF_CAPACITY_ERROR,
+  MRB_JSON_ERROR_COUNT
+};
+
+MRB_API struct RClass *mrb_json_error_class(mrb_state *mrb, enum mrb_json_error err);
+
+#define E_JSON_PARSER_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_PARSER_ERROR))
+#define E_JSON_TAPE_ERROR                       (mrb_json_error_class(mrb, MRB_JSON_TAPE_ERROR))
+#define E_JSON_STRING_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_STRING_ERROR))
+#define E_JSON_UNCLOSED_STRING_ERROR            (mrb_json_error_class(mrb, MRB_JSON_UNCLOSED_STRING_ERROR))
+#define E_JSON_MEMALLOC_ERROR                   (mrb_json_error_class(mrb, MRB_JSON_MEMALLOC_ERROR))
+#define E_JSON_DEPTH_ERROR                      (mrb_json_error_class(mrb, MRB_JSON_DEPTH_ERROR))
+#define E_JSON_UTF8_ERROR                       (mrb_json_error_class(mrb, MRB_JSON_UTF8_ERROR))
+#define E_JSON_NUMBER_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_NUMBER_ERROR))
+#define E_JSON_CAPACITY_ERROR                   (mrb_json_error_class(mrb, MRB_JSON_CAPACITY_ERROR))
+#define E_JSON_INCORRECT_TYPE_ERROR             (mrb_json_error_class(mrb, MRB_JSON_INCORRECT_TYPE_ERROR))
+#define E_JSON_UNSUPPORTED_ARCHITECTURE_ERROR   (mrb_json_error_class(mrb, MRB_JSON_UNSUPPORTED_ARCHITECTURE_ERROR))
+#define E_JSON_EMPTY_INPUT_ERROR                (mrb_json_error_class(mrb, MRB_JSON_EMPTY_INPUT_ERROR))
+#define E_JSON_NO_SUCH_FIELD_ERROR              (mrb_json_error_class(mrb, MRB_JSON_NO_SUCH_FIELD_ERROR))
+#define E_JSON_UNEXPECTED_ERROR                 (mrb_json_error_class(mrb, MRB_JSON_UNEXPECTED_ERROR))
+#define E_JSON_T_ATOM_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_T_ATOM_ERROR))
+#define E_JSON_F_ATOM_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_F_ATOM_ERROR))
+#define E_JSON_N_ATOM_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_N_ATOM_ERROR))
+#define E_JSON_BIGINT_ERROR                     (mrb_json_error_class(mrb, MRB_JSON_BIGINT_ERROR))
+#define E_JSON_UNINITIALIZED_ERROR              (mrb_json_error_class(mrb, MRB_JSON_UNINITIALIZED_ERROR))
+#define E_JSON_UNESCAPED_CHARS_ERROR            (mrb_json_error_class(mrb, MRB_JSON_UNESCAPED_CHARS_ERROR))
+#define E_JSON_NUMBER_OUT_OF_RANGE_ERROR        (mrb_json_error_class(mrb, MRB_JSON_NUMBER_OUT_OF_RANGE_ERROR))
+#define E_JSON_INDEX_OUT_OF_BOUNDS_ERROR        (mrb_json_error_class(mrb, MRB_JSON_INDEX_OUT_OF_BOUNDS_ERROR))
+#define E_JSON_IO_ERROR                         (mrb_json_error_class(mrb, MRB_JSON_IO_ERROR))
+#define E_JSON_INVALID_JSON_POINTER_ERROR       (mrb_json_error_class(mrb, MRB_JSON_INVALID_JSON_POINTER_ERROR))
+#define E_JSON_INVALID_URI_FRAGMENT_ERROR       (mrb_json_error_class(mrb, MRB_JSON_INVALID_URI_FRAGMENT_ERROR))
+#define E_JSON_PARSER_IN_USE_ERROR              (mrb_json_error_class(mrb, MRB_JSON_PARSER_IN_USE_ERROR))
+#define E_JSON_OUT_OF_ORDER_ITERATION_ERROR     (mrb_json_error_class(mrb, MRB_JSON_OUT_OF_ORDER_ITERATION_ERROR))
+#define E_JSON_INSUFFICIENT_PADDING_ERROR       (mrb_json_error_class(mrb, MRB_JSON_INSUFFICIENT_PADDING_ERROR))
+#define E_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR (mrb_json_error_class(mrb, MRB_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR))
+#define E_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR   (mrb_json_error_class(mrb, MRB_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR))
+#define E_JSON_OUT_OF_BOUNDS_ERROR              (mrb_json_error_class(mrb, MRB_JSON_OUT_OF_BOUNDS_ERROR))
+#define E_JSON_TRAILING_CONTENT_ERROR           (mrb_json_error_class(mrb, MRB_JSON_TRAILING_CONTENT_ERROR))
+#define E_JSON_OUT_OF_CAPACITY_ERROR            (mrb_json_error_class(mrb, MRB_JSON_OUT_OF_CAPACITY_ERROR))
 
 MRB_API mrb_value mrb_json_dump(mrb_state *mrb, mrb_value obj);
+/* Appends the JSON for obj to the String buf in chunks and returns buf. */
+MRB_API mrb_value mrb_json_dump_into(mrb_state *mrb, mrb_value obj, mrb_value buf);
 
 MRB_END_DECL
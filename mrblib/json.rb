@@ -1,5 +1,32 @@
 module JSON
-  class << self
-    attr_accessor :zero_copy_parsing
+  class DocumentStream
+    include Enumerable
+  end
+
+  class OndemandDocumentStream
+    include Enumerable
+  end
+
+  class ParserPool
+    # Full parse through the pool's warm DomParser.
+    def parse(str, **opts)
+      JSON.parse(str, dom_parser, **opts)
+    end
+
+    # Yields a pooled Document and checks it back in afterwards.
+    def with_document(str, **opts)
+      doc = parse_lazy(str, **opts)
+      begin
+        yield doc
+      ensure
+        doc.close
+      end
+    end
+  end
+
+  class Element
+    include Enumerable
+    alias length size
+    alias has_key? key?
   end
 end
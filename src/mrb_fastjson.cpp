@@ -9,6 +9,7 @@
 #include <mruby/numeric.h>
 #include <mruby/object.h>
 #include <mruby/presym.h>
+#include <mruby/proc.h>
 #include <mruby/string.h>
 #include <mruby/variable.h>
 #include <mruby/error.h>
@@ -18,6 +19,16 @@ MRB_BEGIN_DECL
 MRB_END_DECL
 #include <mruby/ned.h>
 #include <string_view>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string>
 #include <simdjson.h>
 
 using namespace simdjson;
@@ -25,13 +36,95 @@ using namespace simdjson;
 #ifdef _WIN32
 #include <windows.h>
 #include <sysinfoapi.h>
+#include <sys/stat.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 #include <cstdio>
+#include <cerrno>
+#include <chrono>
 
 static long pagesize;
 
+#ifdef MRB_JSON_STATS
+// JSON.stats counters. Only compiled in when mrbgem.rake defines
+// MRB_JSON_STATS; otherwise every JSON_STAT_* below expands to nothing.
+struct JsonStats {
+  uint64_t bytes_parsed = 0;
+  uint64_t documents = 0;
+  uint64_t padding_copies = 0;
+  uint64_t zero_copy_hits = 0;
+  uint64_t strings = 0;
+  uint64_t keys = 0;
+  uint64_t bigints = 0;
+  uint64_t parse_ns = 0;
+  uint64_t convert_ns = 0;
+  uint64_t errors[NUM_ERROR_CODES] = {};
+};
+#define JSON_STAT_ADD(mrb, field, n) (json_state(mrb)->stats.field += (n))
+#else
+#define JSON_STAT_ADD(mrb, field, n) ((void)0)
+#endif
+
+// Nanosecond lap timers around stage 1+2 and conversion, on top of the
+// counters when MRB_JSON_STATS_TIMERS is defined as well.
+#ifdef MRB_JSON_STATS_TIMERS
+#define JSON_STAT_TIMER(name) auto name = std::chrono::steady_clock::now()
+#define JSON_STAT_LAP(mrb, field, name) do { \
+    auto lap_ = std::chrono::steady_clock::now(); \
+    JSON_STAT_ADD(mrb, field, std::chrono::duration_cast<std::chrono::nanoseconds>(lap_ - name).count()); \
+    name = lap_; \
+  } while (0)
+#else
+#define JSON_STAT_TIMER(name) ((void)0)
+#define JSON_STAT_LAP(mrb, field, name) ((void)0)
+#endif
+
+// Per-state cache of the JSON module, its error classes and the
+// zero_copy_parsing flag, filled in at gem init. It hangs off a hidden ivar
+// on Object, so hot paths and raises pay one ivar lookup instead of a
+// constant lookup per name. The errors ivar keeps the classes reachable
+// even if someone removes the constants.
+struct JsonState {
+  struct RClass *json_mod = nullptr;
+  struct RClass *errors[MRB_JSON_ERROR_COUNT] = {};
+  struct RClass *element_cls = nullptr;
+  struct RClass *raw_cls = nullptr;
+  mrb_bool zero_copy_parsing = FALSE;
+  // Direct-mapped Symbol key -> quoted, escaped JSON for JSON.dump, sized on
+  // first use. Symbols are never freed, so a slot stays valid until evicted.
+  struct SymKey { mrb_sym sym = 0; std::string json; };
+  static constexpr size_t SYM_KEY_SLOTS = 1024;
+  std::vector<SymKey> sym_keys;
+  // Bumped by every top-level JSON.dump and Document#into; an IntoPlan that
+  // was fully compared with its schema in the current epoch is trusted for
+  // as long as the class returns the same hash with the same size.
+  uint64_t plan_epoch = 0;
+  // Direct-mapped class -> DumpHook for JSON.dump, valid for one plan_epoch,
+  // sized on first use. See dump_hook_for().
+  struct HookSlot { struct RClass *cls = nullptr; uint64_t epoch = 0; uint8_t hook = 0; };
+  static constexpr size_t HOOK_SLOTS = 256;
+  std::vector<HookSlot> dump_hooks;
+#ifdef MRB_JSON_STATS
+  JsonStats stats;
+#endif
+};
+
+MRB_CPP_DEFINE_TYPE(JsonState, json_state);
+
+static inline JsonState *json_state(mrb_state *mrb) {
+  return mrb_cpp_get<JsonState>(mrb, mrb_iv_get(mrb, mrb_obj_value(mrb->object_class), MRB_SYM(fast_json_state)));
+}
+
+MRB_API struct RClass *
+mrb_json_error_class(mrb_state *mrb, enum mrb_json_error err)
+{
+  return json_state(mrb)->errors[err];
+}
+
 static bool need_allocation(const char* buf, mrb_int len, mrb_int capa)
 {
 #ifdef MRB_DEBUG
@@ -51,18 +144,22 @@ simdjson_safe_view_from_mrb_string(mrb_state *mrb, mrb_value str,
                                    padded_string &jsonbuffer) {
   mrb_int len = RSTRING_LEN(str);
   struct RString* rs = mrb_str_ptr(str);
+  JSON_STAT_ADD(mrb, bytes_parsed, len);
   if (RSTR_SHARED_P(rs) || RSTR_FSHARED_P(rs)) {
     mrb_str_modify(mrb, rs);
+    JSON_STAT_ADD(mrb, padding_copies, 1);
     jsonbuffer = padded_string(RSTRING_PTR(str), len);
     return jsonbuffer;
   }
-  if (mrb_test(mrb_iv_get(mrb, mrb_obj_value(mrb_module_get_id(mrb, MRB_SYM(JSON))), MRB_IVSYM(zero_copy_parsing)))) {
+  if (json_state(mrb)->zero_copy_parsing) {
     if (likely(!need_allocation(RSTRING_PTR(str), len, RSTRING_CAPA(str)))) {
       str = mrb_obj_freeze(mrb, str);
+      JSON_STAT_ADD(mrb, zero_copy_hits, 1);
       return padded_string_view(RSTRING_PTR(str), len, len + SIMDJSON_PADDING);
     }
   }
   if (mrb_frozen_p(mrb_obj_ptr(str))) {
+    JSON_STAT_ADD(mrb, padding_copies, 1);
     jsonbuffer = padded_string(RSTRING_PTR(str), len);
     return jsonbuffer;
   }
@@ -70,6 +167,7 @@ simdjson_safe_view_from_mrb_string(mrb_state *mrb, mrb_value str,
     mrb_raise(mrb, E_RUNTIME_ERROR, "JSON input too large for padding");
   mrb_int required = len + SIMDJSON_PADDING;
   if (RSTRING_CAPA(str) < required) {
+    JSON_STAT_ADD(mrb, padding_copies, 1);
     str = mrb_str_resize(mrb, str, required);
     str = mrb_obj_freeze(mrb, str);
     RSTR_SET_LEN(RSTRING(str), len);
@@ -77,61 +175,175 @@ simdjson_safe_view_from_mrb_string(mrb_state *mrb, mrb_value str,
   return padded_string_view(RSTRING_PTR(str), len, required);
 }
 
-static void raise_simdjson_error(mrb_state *mrb, const error_code code) {
-  const char *msg = error_message(code);
+// For callers that only read the input (JSON.valid?, validate!, reformat):
+// the caller's String is never padded, resized or frozen. Its bytes are used
+// in place when the padding is readable anyway, and copied otherwise. The
+// capacity of a shared String belongs to the shared buffer, so only the page
+// check applies there.
+static padded_string_view
+simdjson_readonly_view_from_mrb_string(mrb_state *mrb, mrb_value str,
+                                       padded_string &jsonbuffer) {
+  mrb_int len = RSTRING_LEN(str);
+  struct RString* rs = mrb_str_ptr(str);
+  JSON_STAT_ADD(mrb, bytes_parsed, len);
+  const mrb_int capa = RSTR_SHARED_P(rs) || RSTR_FSHARED_P(rs) ? 0 : RSTRING_CAPA(str);
+  if (likely(len > 0 && !need_allocation(RSTRING_PTR(str), len, capa))) {
+    JSON_STAT_ADD(mrb, zero_copy_hits, 1);
+    return padded_string_view(RSTRING_PTR(str), len, len + SIMDJSON_PADDING);
+  }
+  JSON_STAT_ADD(mrb, padding_copies, 1);
+  jsonbuffer = padded_string(RSTRING_PTR(str), len);
+  return jsonbuffer;
+}
+
+static struct RClass *simdjson_error_class(mrb_state *mrb, const error_code code) {
   switch (code) {
-  case UNCLOSED_STRING:     mrb_raise(mrb, E_JSON_UNCLOSED_STRING_ERROR, msg); break;
-  case STRING_ERROR:        mrb_raise(mrb, E_JSON_STRING_ERROR, msg); break;
-  case UNESCAPED_CHARS:     mrb_raise(mrb, E_JSON_UNESCAPED_CHARS_ERROR, msg); break;
-  case TAPE_ERROR:          mrb_raise(mrb, E_JSON_TAPE_ERROR, msg); break;
-  case DEPTH_ERROR:         mrb_raise(mrb, E_JSON_DEPTH_ERROR, msg); break;
-  case INCOMPLETE_ARRAY_OR_OBJECT: mrb_raise(mrb, E_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR, msg); break;
-  case TRAILING_CONTENT:    mrb_raise(mrb, E_JSON_TRAILING_CONTENT_ERROR, msg); break;
-  case MEMALLOC:            mrb_exc_raise(mrb, mrb_obj_value(mrb->nomem_err)); break;
-  case CAPACITY:            mrb_raise(mrb, E_JSON_CAPACITY_ERROR, msg); break;
-  case OUT_OF_CAPACITY:     mrb_raise(mrb, E_JSON_OUT_OF_CAPACITY_ERROR, msg); break;
-  case INSUFFICIENT_PADDING: mrb_raise(mrb, E_JSON_INSUFFICIENT_PADDING_ERROR, msg); break;
-  case NUMBER_ERROR:        mrb_raise(mrb, E_JSON_NUMBER_ERROR, msg); break;
-  case BIGINT_ERROR:        mrb_raise(mrb, E_JSON_BIGINT_ERROR, msg); break;
-  case NUMBER_OUT_OF_RANGE: mrb_raise(mrb, E_JSON_NUMBER_OUT_OF_RANGE_ERROR, msg); break;
-  case T_ATOM_ERROR:        mrb_raise(mrb, E_JSON_T_ATOM_ERROR, msg); break;
-  case F_ATOM_ERROR:        mrb_raise(mrb, E_JSON_F_ATOM_ERROR, msg); break;
-  case N_ATOM_ERROR:        mrb_raise(mrb, E_JSON_N_ATOM_ERROR, msg); break;
-  case UTF8_ERROR:          mrb_raise(mrb, E_JSON_UTF8_ERROR, msg); break;
-  case EMPTY:               mrb_raise(mrb, E_JSON_EMPTY_INPUT_ERROR, msg); break;
-  case UNINITIALIZED:       mrb_raise(mrb, E_JSON_UNINITIALIZED_ERROR, msg); break;
-  case PARSER_IN_USE:       mrb_raise(mrb, E_JSON_PARSER_IN_USE_ERROR, msg); break;
-  case SCALAR_DOCUMENT_AS_VALUE: mrb_raise(mrb, E_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR, msg); break;
-  case INCORRECT_TYPE:      mrb_raise(mrb, E_TYPE_ERROR, msg); break;
-  case NO_SUCH_FIELD:       mrb_raise(mrb, E_JSON_NO_SUCH_FIELD_ERROR, msg); break;
-  case INDEX_OUT_OF_BOUNDS: mrb_raise(mrb, E_INDEX_ERROR, msg); break;
-  case OUT_OF_BOUNDS:       mrb_raise(mrb, E_JSON_OUT_OF_BOUNDS_ERROR, msg); break;
-  case OUT_OF_ORDER_ITERATION: mrb_raise(mrb, E_JSON_OUT_OF_ORDER_ITERATION_ERROR, msg); break;
-  case IO_ERROR:            mrb_raise(mrb, E_JSON_IO_ERROR, msg); break;
-  case INVALID_JSON_POINTER: mrb_raise(mrb, E_JSON_INVALID_JSON_POINTER_ERROR, msg); break;
-  case INVALID_URI_FRAGMENT: mrb_raise(mrb, E_JSON_INVALID_URI_FRAGMENT_ERROR, msg); break;
-  case UNSUPPORTED_ARCHITECTURE: mrb_raise(mrb, E_JSON_UNSUPPORTED_ARCHITECTURE_ERROR, msg); break;
-  case UNEXPECTED_ERROR:    mrb_raise(mrb, E_JSON_UNEXPECTED_ERROR, msg); break;
-  default:                  mrb_raise(mrb, E_JSON_PARSER_ERROR, msg); break;
-  }
-}
-
-static mrb_value convert_array(mrb_state* mrb, const dom::element& arr_el, mrb_bool symbolize_names);
-static mrb_value convert_object(mrb_state* mrb, const dom::element& obj_el, mrb_bool symbolize_names);
-
-static mrb_value convert_element(mrb_state *mrb, const dom::element& el, mrb_bool symbolize_names) {
+  case UNCLOSED_STRING:     return E_JSON_UNCLOSED_STRING_ERROR;
+  case STRING_ERROR:        return E_JSON_STRING_ERROR;
+  case UNESCAPED_CHARS:     return E_JSON_UNESCAPED_CHARS_ERROR;
+  case TAPE_ERROR:          return E_JSON_TAPE_ERROR;
+  case DEPTH_ERROR:         return E_JSON_DEPTH_ERROR;
+  case INCOMPLETE_ARRAY_OR_OBJECT: return E_JSON_INCOMPLETE_ARRAY_OR_OBJECT_ERROR;
+  case TRAILING_CONTENT:    return E_JSON_TRAILING_CONTENT_ERROR;
+  case MEMALLOC:            return mrb_obj_class(mrb, mrb_obj_value(mrb->nomem_err));
+  case CAPACITY:            return E_JSON_CAPACITY_ERROR;
+  case OUT_OF_CAPACITY:     return E_JSON_OUT_OF_CAPACITY_ERROR;
+  case INSUFFICIENT_PADDING: return E_JSON_INSUFFICIENT_PADDING_ERROR;
+  case NUMBER_ERROR:        return E_JSON_NUMBER_ERROR;
+  case BIGINT_ERROR:        return E_JSON_BIGINT_ERROR;
+  case NUMBER_OUT_OF_RANGE: return E_JSON_NUMBER_OUT_OF_RANGE_ERROR;
+  case T_ATOM_ERROR:        return E_JSON_T_ATOM_ERROR;
+  case F_ATOM_ERROR:        return E_JSON_F_ATOM_ERROR;
+  case N_ATOM_ERROR:        return E_JSON_N_ATOM_ERROR;
+  case UTF8_ERROR:          return E_JSON_UTF8_ERROR;
+  case EMPTY:               return E_JSON_EMPTY_INPUT_ERROR;
+  case UNINITIALIZED:       return E_JSON_UNINITIALIZED_ERROR;
+  case PARSER_IN_USE:       return E_JSON_PARSER_IN_USE_ERROR;
+  case SCALAR_DOCUMENT_AS_VALUE: return E_JSON_SCALAR_DOCUMENT_AS_VALUE_ERROR;
+  case INCORRECT_TYPE:      return E_TYPE_ERROR;
+  case NO_SUCH_FIELD:       return E_JSON_NO_SUCH_FIELD_ERROR;
+  case INDEX_OUT_OF_BOUNDS: return E_INDEX_ERROR;
+  case OUT_OF_BOUNDS:       return E_JSON_OUT_OF_BOUNDS_ERROR;
+  case OUT_OF_ORDER_ITERATION: return E_JSON_OUT_OF_ORDER_ITERATION_ERROR;
+  case IO_ERROR:            return E_JSON_IO_ERROR;
+  case INVALID_JSON_POINTER: return E_JSON_INVALID_JSON_POINTER_ERROR;
+  case INVALID_URI_FRAGMENT: return E_JSON_INVALID_URI_FRAGMENT_ERROR;
+  case UNSUPPORTED_ARCHITECTURE: return E_JSON_UNSUPPORTED_ARCHITECTURE_ERROR;
+  case UNEXPECTED_ERROR:    return E_JSON_UNEXPECTED_ERROR;
+  default:                  return E_JSON_PARSER_ERROR;
+  }
+}
+
+static void raise_simdjson_error(mrb_state *mrb, const error_code code) {
+  if (static_cast<unsigned>(code) < NUM_ERROR_CODES) JSON_STAT_ADD(mrb, errors[code], 1);
+  if (code == MEMALLOC) mrb_exc_raise(mrb, mrb_obj_value(mrb->nomem_err));
+  mrb_raise(mrb, simdjson_error_class(mrb, code), error_message(code));
+}
+
+// Direct-mapped cache of frozen key strings for one conversion. Record-shaped
+// data repeats a handful of keys, so a small table catches nearly all of them
+// without heap allocation; a collision just allocates a fresh key. The table
+// is a SLOTS-long Array, so an evicted key is no longer referenced and the GC
+// can take it: the cache holds at most SLOTS keys however many it has seen.
+class KeyCache {
+public:
+  // Construct before the caller saves its arena so the table stays protected.
+  explicit KeyCache(mrb_state *mrb) : mrb(mrb), table(mrb_ary_new_capa(mrb, SLOTS)) {
+    mrb_gc_protect(mrb, table);
+    mrb_ary_set(mrb, table, SLOTS - 1, mrb_nil_value());
+  }
+
+  mrb_value fetch(std::string_view sv) {
+    const mrb_int idx = static_cast<mrb_int>(hash(sv) & (SLOTS - 1));
+    mrb_value slot = RARRAY_PTR(table)[idx];
+    if (mrb_string_p(slot) && static_cast<size_t>(RSTRING_LEN(slot)) == sv.size() &&
+        std::memcmp(RSTRING_PTR(slot), sv.data(), sv.size()) == 0)
+      return slot;
+    mrb_value key = mrb_obj_freeze(mrb, mrb_str_new(mrb, sv.data(), sv.size()));
+    JSON_STAT_ADD(mrb, keys, 1);
+    mrb_ary_set(mrb, table, idx, key);
+    return key;
+  }
+
+  // For owners that outlive one method call and root the table themselves.
+  mrb_value roots() const { return table; }
+
+private:
+  static constexpr mrb_int SLOTS = 256;
+  static size_t hash(std::string_view sv) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : sv) { h ^= c; h *= 16777619u; }
+    return h;
+  }
+  mrb_state *mrb;
+  mrb_value table;
+};
+
+// What integers beyond 64 bits become: Integer (a bigint), the digits as a
+// String, or a JSON::Raw that dumps them back verbatim.
+enum BigintMode : uint8_t { BIGINT_AS_INTEGER, BIGINT_AS_STRING, BIGINT_AS_RAW };
+
+struct ConvertOptions {
+  mrb_bool symbolize_names = FALSE;
+  KeyCache *key_cache = nullptr;
+  BigintMode bigint = BIGINT_AS_INTEGER;
+  // shared_strings: the frozen String being parsed in place. OnDemand
+  // strings without escapes become substrings sharing its buffer.
+  const char *shared_base = nullptr;
+  mrb_value shared_source = mrb_nil_value();
+  // Resolved once by the entry point. Only bigint: :raw reads it, so the
+  // internal ConvertOptions{} for plain integers can leave it unset.
+  JsonState *state = nullptr;
+};
+
+// Fresh keys are frozen up front, otherwise mrb_hash_set would dup them.
+static mrb_value convert_key(mrb_state *mrb, std::string_view sv, const ConvertOptions &opts) {
+  if (opts.symbolize_names) return mrb_symbol_value(mrb_intern(mrb, sv.data(), sv.size()));
+  if (opts.key_cache) return opts.key_cache->fetch(sv);
+  JSON_STAT_ADD(mrb, keys, 1);
+  return mrb_obj_freeze(mrb, mrb_str_new(mrb, sv.data(), sv.size()));
+}
+
+// Appends to an array made by mrb_ary_new_capa(mrb, capa) that nothing else
+// has seen yet, so mrb_ary_push's frozen/shared/capacity checks can be
+// skipped. The length goes up with each store to keep the GC consistent.
+// Past capa (the DOM reports saturated sizes) it falls back to mrb_ary_push.
+static inline void json_ary_append(mrb_state *mrb, mrb_value ary, mrb_int capa, mrb_value v) {
+  struct RArray *a = mrb_ary_ptr(ary);
+  mrb_int len = RARRAY_LEN(ary);
+  if (unlikely(len >= capa)) { mrb_ary_push(mrb, ary, v); return; }
+  ARY_PTR(a)[len] = v;
+  ARY_SET_LEN(a, len + 1);
+  if (!mrb_immediate_p(v)) mrb_field_write_barrier(mrb, reinterpret_cast<struct RBasic *>(a), mrb_basic_ptr(v));
+}
+
+static mrb_value json_bigint_from_digits(mrb_state *mrb, std::string_view raw, const ConvertOptions &opts);
+
+// Unsigned values past MRB_INT_MAX are bigints as far as Ruby is concerned,
+// so the bigint: mode covers them too.
+static inline mrb_value json_uint64_to_mrb(mrb_state *mrb, uint64_t num, const ConvertOptions &opts) {
+  if (likely(opts.bigint == BIGINT_AS_INTEGER || num <= static_cast<uint64_t>(MRB_INT_MAX))) return mrb_convert_number(mrb, num);
+  char digits[20];
+  auto res = std::to_chars(digits, digits + sizeof(digits), num);
+  return json_bigint_from_digits(mrb, std::string_view(digits, res.ptr - digits), opts);
+}
+
+static mrb_value convert_array(mrb_state* mrb, const dom::element& arr_el, const ConvertOptions &opts);
+static mrb_value convert_object(mrb_state* mrb, const dom::element& obj_el, const ConvertOptions &opts);
+
+static mrb_value convert_element(mrb_state *mrb, const dom::element& el, const ConvertOptions &opts) {
   using namespace dom;
   error_code code;
   switch (el.type()) {
-  case element_type::ARRAY:   return convert_array(mrb, el, symbolize_names);
-  case element_type::OBJECT:  return convert_object(mrb, el, symbolize_names);
+  case element_type::ARRAY:   return convert_array(mrb, el, opts);
+  case element_type::OBJECT:  return convert_object(mrb, el, opts);
   case element_type::INT64: {
     int64_t num; code = el.get_int64().get(num);
     if (likely(code == SUCCESS)) return mrb_convert_number(mrb, num);
   } break;
   case element_type::UINT64: {
     uint64_t num; code = el.get_uint64().get(num);
-    if (likely(code == SUCCESS)) return mrb_convert_number(mrb, num);
+    if (likely(code == SUCCESS)) return json_uint64_to_mrb(mrb, num, opts);
   } break;
   case element_type::DOUBLE: {
     double num; code = el.get_double().get(num);
@@ -139,6 +351,7 @@ static mrb_value convert_element(mrb_state *mrb, const dom::element& el, mrb_boo
   } break;
   case element_type::STRING: {
     std::string_view sv; code = el.get_string().get(sv);
+    JSON_STAT_ADD(mrb, strings, 1);
     if (likely(code == SUCCESS)) return mrb_str_new(mrb, sv.data(), sv.size());
   } break;
   case element_type::BOOL: {
@@ -152,15 +365,16 @@ static mrb_value convert_element(mrb_state *mrb, const dom::element& el, mrb_boo
   return mrb_undef_value();
 }
 
-static mrb_value convert_array(mrb_state *mrb, const dom::element& arr_el, mrb_bool symbolize_names) {
+static mrb_value convert_array(mrb_state *mrb, const dom::element& arr_el, const ConvertOptions &opts) {
   dom::array arr;
   auto code = arr_el.get_array().get(arr);
   if (likely(code == SUCCESS)) {
-    mrb_value ary = mrb_ary_new_capa(mrb, arr.size());
+    const mrb_int capa = static_cast<mrb_int>(arr.size());
+    mrb_value ary = mrb_ary_new_capa(mrb, capa);
     mrb_gc_protect(mrb, ary);
     int idx = mrb_gc_arena_save(mrb);
     for (dom::element item : arr) {
-      mrb_ary_push(mrb, ary, convert_element(mrb, item, symbolize_names));
+      json_ary_append(mrb, ary, capa, convert_element(mrb, item, opts));
       mrb_gc_arena_restore(mrb, idx);
     }
     return ary;
@@ -169,21 +383,16 @@ static mrb_value convert_array(mrb_state *mrb, const dom::element& arr_el, mrb_b
   return mrb_undef_value();
 }
 
-using KeyConverterFn = mrb_value (*)(mrb_state *, std::string_view);
-static mrb_value convert_key_as_str(mrb_state *mrb, std::string_view sv) { return mrb_str_new(mrb, sv.data(), sv.size()); }
-static mrb_value convert_key_as_sym(mrb_state *mrb, std::string_view sv) { return mrb_symbol_value(mrb_intern(mrb, sv.data(), sv.size())); }
-
-static mrb_value convert_object(mrb_state *mrb, const dom::element& obj_el, mrb_bool symbolize_names) {
+static mrb_value convert_object(mrb_state *mrb, const dom::element& obj_el, const ConvertOptions &opts) {
   dom::object obj;
   auto code = obj_el.get_object().get(obj);
   if (likely(code == SUCCESS)) {
     mrb_value hash = mrb_hash_new_capa(mrb, obj.size());
     mrb_gc_protect(mrb, hash);
     int idx = mrb_gc_arena_save(mrb);
-    KeyConverterFn convert_key = symbolize_names ? convert_key_as_sym : convert_key_as_str;
     for (auto &kv : obj) {
-      mrb_value key = convert_key(mrb, kv.key);
-      mrb_value val = convert_element(mrb, kv.value, symbolize_names);
+      mrb_value key = convert_key(mrb, kv.key, opts);
+      mrb_value val = convert_element(mrb, kv.value, opts);
       mrb_hash_set(mrb, hash, key, val);
       mrb_gc_arena_restore(mrb, idx);
     }
@@ -215,37 +424,777 @@ static mrb_value mrb_dom_parser_allocate(mrb_state *mrb, mrb_value self) {
   return mrb_undef_value();
 }
 
+static mrb_value json_ondemand_parse_convert(mrb_state *mrb, const char *buf, size_t len, const ConvertOptions &opts);
+
+// A failed stage 2 leaves a half-built tape behind, possibly over the root
+// word of an earlier document. Every DOM path that parses into a DomParser's
+// own document clears that word on failure, so DomParser#dump_tape can tell
+// there is nothing to dump.
+static inline void dom_parser_forget_tape(dom::parser *parser) {
+  if (parser->doc.tape) parser->doc.tape[0] = 0;
+}
+
+// Stage 1+2 plus conversion of one document, shared by the DOM entry points
+// so the stats timers split the two phases in one place. The tape has no
+// room for integers beyond 64 bits, so those documents are converted again
+// through OnDemand, which hands the digit run to json_bigint_from_digits.
+static mrb_value json_dom_parse_convert(mrb_state *mrb, dom::parser *parser, const char *buf, size_t len, const ConvertOptions &opts) {
+  JSON_STAT_TIMER(lap);
+  dom::element element;
+  auto code = parser->parse(buf, len, false).get(element);
+  JSON_STAT_LAP(mrb, parse_ns, lap);
+  if (unlikely(code != SUCCESS)) {
+    dom_parser_forget_tape(parser);
+    if (code == BIGINT_ERROR) return json_ondemand_parse_convert(mrb, buf, len, opts);
+    raise_simdjson_error(mrb, code);
+  }
+  JSON_STAT_ADD(mrb, documents, 1);
+  mrb_value out = convert_element(mrb, element, opts);
+  JSON_STAT_LAP(mrb, convert_ns, lap);
+  return out;
+}
+
 static mrb_value mrb_dom_parser_parse(mrb_state *mrb, mrb_value self) {
   mrb_value arg;
   mrb_get_args(mrb, "S", &arg);
   dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, self);
   padded_string jsonbuffer;
   auto view = simdjson_safe_view_from_mrb_string(mrb, arg, jsonbuffer);
-  dom::element element;
-  auto code = parser->parse(view).get(element);
-  if (likely(code == SUCCESS)) return convert_element(mrb, element, false);
+  return json_dom_parse_convert(mrb, parser, view.data(), view.length(), ConvertOptions{});
+}
+
+// JSON.parse and JSON.load_file share one parser per mrb_state. The tape
+// only grows, and conversion finishes before any Ruby code can run, so no
+// caller ever observes another caller's document.
+static mrb_value json_default_dom_parser(mrb_state *mrb, struct RClass *json_mod) {
+  mrb_value parser = mrb_iv_get(mrb, mrb_obj_value(json_mod), MRB_SYM(default_dom_parser));
+  if (likely(!mrb_nil_p(parser))) return parser;
+  parser = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(DomParser)), 0, NULL);
+  mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(default_dom_parser), parser);
+  return parser;
+}
+
+static mrb_value mrb_json_zero_copy_parsing(mrb_state *mrb, mrb_value self) {
+  return mrb_bool_value(json_state(mrb)->zero_copy_parsing);
+}
+
+static mrb_value mrb_json_set_zero_copy_parsing(mrb_state *mrb, mrb_value self) {
+  mrb_value flag;
+  mrb_get_args(mrb, "o", &flag);
+  json_state(mrb)->zero_copy_parsing = mrb_test(flag);
+  return flag;
+}
+
+#ifdef MRB_JSON_STATS
+static mrb_value mrb_json_stats(mrb_state *mrb, mrb_value self) {
+  const JsonStats &s = json_state(mrb)->stats;
+  mrb_value out = mrb_hash_new_capa(mrb, 12);
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(bytes_parsed)),   mrb_convert_number(mrb, s.bytes_parsed));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(documents)),      mrb_convert_number(mrb, s.documents));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(padding_copies)), mrb_convert_number(mrb, s.padding_copies));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(zero_copy_hits)), mrb_convert_number(mrb, s.zero_copy_hits));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(strings)),        mrb_convert_number(mrb, s.strings));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(keys)),           mrb_convert_number(mrb, s.keys));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(bigints)),        mrb_convert_number(mrb, s.bigints));
+#ifdef MRB_JSON_STATS_TIMERS
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(parse_ns)),       mrb_convert_number(mrb, s.parse_ns));
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(convert_ns)),     mrb_convert_number(mrb, s.convert_ns));
+#endif
+  // Several error codes can share a class (e.g. INCORRECT_TYPE and TypeError).
+  mrb_value errors = mrb_hash_new(mrb);
+  mrb_hash_set(mrb, out, mrb_symbol_value(MRB_SYM(errors)), errors);
+  for (int code = 0; code < NUM_ERROR_CODES; code++) {
+    if (s.errors[code] == 0) continue;
+    mrb_value cls = mrb_obj_value(simdjson_error_class(mrb, static_cast<error_code>(code)));
+    mrb_value prev = mrb_hash_fetch(mrb, errors, cls, mrb_nil_value());
+    uint64_t n = s.errors[code] + (mrb_integer_p(prev) ? static_cast<uint64_t>(mrb_integer(prev)) : 0);
+    mrb_hash_set(mrb, errors, cls, mrb_convert_number(mrb, n));
+  }
+  return out;
+}
+
+static mrb_value mrb_json_reset_stats(mrb_state *mrb, mrb_value self) {
+  json_state(mrb)->stats = JsonStats{};
+  return mrb_nil_value();
+}
+#endif
+
+static mrb_value mrb_json_default_parser_capacity(mrb_state *mrb, mrb_value self) {
+  dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, json_default_dom_parser(mrb, mrb_class_ptr(self)));
+  return mrb_convert_number(mrb, parser->capacity());
+}
+
+static mrb_value mrb_json_set_default_parser_capacity(mrb_state *mrb, mrb_value self) {
+  mrb_int capacity;
+  mrb_get_args(mrb, "i", &capacity);
+  if (unlikely(capacity < 0)) mrb_raise(mrb, E_ARGUMENT_ERROR, "capacity must not be negative");
+  dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, json_default_dom_parser(mrb, mrb_class_ptr(self)));
+  if (unlikely(static_cast<size_t>(capacity) > parser->max_capacity()))
+    mrb_raise(mrb, E_JSON_CAPACITY_ERROR, error_message(CAPACITY));
+  auto code = parser->allocate(capacity, parser->max_depth());
+  if (likely(code == SUCCESS)) code = parser->doc.allocate(capacity);
+  if (likely(code == SUCCESS)) return mrb_convert_number(mrb, capacity);
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+// Kernel selection. simdjson keeps the active implementation in one
+// process-wide slot, so a switch affects every mrb_state. Parsers bind
+// their kernel on first allocation: the interpreter's default parsers are
+// recreated here (keeping the DOM parser's capacity), parsers the caller
+// holds keep the kernel they started with.
+static mrb_value mrb_json_implementations(mrb_state *mrb, mrb_value self) {
+  mrb_value names = mrb_ary_new(mrb);
+  for (const auto *impl : simdjson::get_available_implementations()) {
+    if (!impl->supported_by_runtime_system()) continue;
+    const std::string name = impl->name();
+    mrb_ary_push(mrb, names, mrb_str_new(mrb, name.data(), name.size()));
+  }
+  return names;
+}
+
+static mrb_value mrb_json_implementation(mrb_state *mrb, mrb_value self) {
+  const std::string name = simdjson::get_active_implementation()->name();
+  return mrb_str_new(mrb, name.data(), name.size());
+}
+
+static mrb_value mrb_json_set_implementation(mrb_state *mrb, mrb_value self) {
+  mrb_value name;
+  mrb_get_args(mrb, "S", &name);
+  const simdjson::implementation *impl =
+    simdjson::get_available_implementations()[std::string_view(RSTRING_PTR(name), RSTRING_LEN(name))];
+  if (unlikely(!impl || !impl->supported_by_runtime_system()))
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "SIMD implementation %v is not available on this CPU", name);
+  if (impl == simdjson::get_active_implementation()) return name;
+  struct RClass *json_mod = mrb_class_ptr(self);
+  mrb_value old_dom = mrb_iv_get(mrb, mrb_obj_value(json_mod), MRB_SYM(default_dom_parser));
+  const size_t capacity = mrb_nil_p(old_dom) ? 0 : mrb_cpp_get<dom::parser>(mrb, old_dom)->capacity();
+  simdjson::get_active_implementation() = impl;
+  mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(default_dom_parser), mrb_nil_value());
+  mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(default_ondemand_parser), mrb_nil_value());
+  mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(threaded_parsers), mrb_nil_value());
+  if (capacity > 0) {
+    dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, json_default_dom_parser(mrb, json_mod));
+    auto code = parser->allocate(capacity, parser->max_depth());
+    if (likely(code == SUCCESS)) code = parser->doc.allocate(capacity);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  }
+  return name;
+}
+
+// UTF-8 check alone, on the active kernel; no JSON involved.
+static mrb_value mrb_json_valid_utf8_p(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+  return mrb_bool_value(simdjson::validate_utf8(RSTRING_PTR(str), RSTRING_LEN(str)));
+}
+
+static inline mrb_bool kwarg_test(mrb_value v) { return !mrb_undef_p(v) && mrb_test(v); }
+
+static void convert_options_from_kwargs(mrb_state *mrb, mrb_value symbolize_names, mrb_value cache_keys,
+                                        ConvertOptions &opts, std::optional<KeyCache> &key_cache) {
+  opts.state = json_state(mrb);
+  opts.symbolize_names = kwarg_test(symbolize_names);
+  if (kwarg_test(cache_keys)) opts.key_cache = &key_cache.emplace(mrb);
+}
+
+// ============================================================================
+// Threaded top-level arrays — JSON.parse(str, threads: n) / JSON.dump(ary, threads: n)
+// Workers only ever touch simdjson buffers (parse) or read plain mruby
+// containers without allocating (dump); every mruby object is created on the
+// calling thread after the workers have been joined. Per-call state lives in
+// fixed-size stack arrays so a later raise cannot leak it.
+// ============================================================================
+
+static constexpr size_t THREADED_MAX_WORKERS = 64;
+static constexpr size_t THREADED_MIN_CHUNK_BYTES = 1 << 20;
+
+static size_t threads_from_kwarg(mrb_state *mrb, mrb_value threads) {
+  if (mrb_undef_p(threads) || mrb_nil_p(threads)) return 1;
+  mrb_int n = mrb_integer(mrb_ensure_int_type(mrb, threads));
+  if (unlikely(n <= 0)) mrb_raise(mrb, E_ARGUMENT_ERROR, "threads must be positive");
+  return std::min(static_cast<size_t>(n), THREADED_MAX_WORKERS);
+}
+
+// Runs fn(0) .. fn(n - 1), fn(0) on the calling thread. If a thread cannot be
+// started its share runs inline, so the result never depends on the OS.
+template <typename Fn>
+static void run_workers(size_t n, Fn &&fn) {
+  std::array<std::thread, THREADED_MAX_WORKERS> workers;
+  for (size_t i = 1; i < n; ++i) {
+    try { workers[i] = std::thread(fn, i); }
+    catch (const std::system_error &) { fn(i); }
+  }
+  fn(0);
+  for (size_t i = 1; i < n; ++i) if (workers[i].joinable()) workers[i].join();
+}
+
+struct ParseChunk {
+  std::string_view src;
+  char *buf = nullptr;
+  dom::parser *parser = nullptr;
+  dom::element root;
+  error_code code = UNINITIALIZED;
+};
+
+// One region of the split scan, scanned as if it started outside a string
+// (hyp[0]) and inside one (hyp[1]); which guess was right is only known once
+// the regions before it are combined. comma[k] is the first comma at k
+// levels above the region's starting depth.
+struct SplitScan {
+  static constexpr size_t MAX_DEPTH = 32;
+  static constexpr size_t NONE = SIZE_MAX;
+  size_t comma[MAX_DEPTH];
+  long delta;       // depth at the end, relative to the start
+  bool in_string;   // state at the end
+};
+
+static void split_scan_region(const char *b, size_t from, size_t to, bool in_string, SplitScan &out) {
+  std::fill(std::begin(out.comma), std::end(out.comma), SplitScan::NONE);
+  // inside a string, an odd run of backslashes right before `from` escapes b[from]
+  bool escape = false;
+  if (in_string) {
+    size_t k = from;
+    while (k > 0 && b[k - 1] == '\\') --k;
+    escape = (from - k) & 1;
+  }
+  long depth = 0;
+  for (size_t i = from; i < to; ++i) {
+    const char c = b[i];
+    if (in_string) {
+      if (escape) escape = false;
+      else if (c == '\\') escape = true;
+      else if (c == '"') in_string = false;
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      depth--;
+    } else if (c == ',' && depth <= 0 && static_cast<size_t>(-depth) < SplitScan::MAX_DEPTH &&
+               out.comma[-depth] == SplitScan::NONE) {
+      out.comma[-depth] = i;
+    }
+  }
+  out.delta = depth;
+  out.in_string = in_string;
+}
+
+// Cuts the root array into at most `parts` runs of whole elements of roughly
+// equal byte size, without a serial pass over the input: the bytes between
+// the brackets are cut into `parts` even regions, each worker scans its own
+// region for string and nesting state under both guesses, and a serial step
+// over the per-region summaries picks the first top-level comma in each
+// region. Only well-formed input is guaranteed to be cut at real element
+// boundaries; a bad cut makes that chunk fail to parse, and the caller goes
+// back to the serial parser. Returns 0 when the root is not an array or a
+// chunk would be empty (`[1,]` must not parse as `[1]` plus `[]`).
+static size_t split_top_level_array(padded_string_view view, size_t parts, std::array<ParseChunk, THREADED_MAX_WORKERS> &chunks) {
+  const char *b = view.data();
+  auto space = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+  size_t first = 0, last = view.length();
+  while (first < last && space(b[first])) ++first;
+  while (last > first && space(b[last - 1])) --last;
+  if (last - first < 2 || b[first] != '[' || b[last - 1] != ']') return 0;
+  ++first; --last; // elements live in [first, last)
+
+  const size_t step = (last - first) / parts;
+  auto region_from = [&](size_t r) { return first + r * step; };
+  auto region_to   = [&](size_t r) { return r + 1 == parts ? last : first + (r + 1) * step; };
+  std::array<std::array<SplitScan, 2>, THREADED_MAX_WORKERS> scans;
+  run_workers(parts, [&](size_t r) {
+    split_scan_region(b, region_from(r), region_to(r), false, scans[r][0]);
+    if (r > 0) split_scan_region(b, region_from(r), region_to(r), true, scans[r][1]);
+  });
+
+  size_t n = 0, start = first;
+  auto cut = [&](size_t end) {
+    size_t i = start;
+    while (i < end && space(b[i])) ++i;
+    if (i == end) return false;
+    chunks[n++].src = std::string_view(b + start, end - start);
+    start = end + 1;
+    return true;
+  };
+  long depth = 1;
+  bool in_string = false;
+  for (size_t r = 0; r < parts; ++r) {
+    const SplitScan &scan = scans[r][in_string];
+    const long k = depth - 1;
+    if (r > 0 && k >= 0 && static_cast<size_t>(k) < SplitScan::MAX_DEPTH && scan.comma[k] != SplitScan::NONE &&
+        !cut(scan.comma[k]))
+      return 0;
+    depth += scan.delta;
+    in_string = scan.in_string;
+  }
+  return cut(last) ? n : 0;
+}
+
+static void parse_chunk(ParseChunk &c) {
+  const size_t len = c.src.size() + 2;
+  c.buf[0] = '[';
+  std::memcpy(c.buf + 1, c.src.data(), c.src.size());
+  c.buf[len - 1] = ']';
+  std::memset(c.buf + len, 0, SIMDJSON_PADDING);
+  c.code = c.parser->parse(c.buf, len, false).get(c.root);
+}
+
+// Returns undef when the input is not worth splitting (too small, not an
+// array, or malformed); the caller falls back to the serial parser, which
+// also reports errors with their proper position.
+static mrb_value json_parse_array_threaded(mrb_state *mrb, padded_string_view view, size_t threads, const ConvertOptions &opts) {
+  threads = std::min(threads, view.length() / THREADED_MIN_CHUNK_BYTES);
+  if (threads < 2) return mrb_undef_value();
+  std::array<ParseChunk, THREADED_MAX_WORKERS> chunks;
+  const size_t n = split_top_level_array(view, threads, chunks);
+  if (n < 2) return mrb_undef_value();
+
+  // Worker parsers and their chunk buffers live in a per-state pool, like
+  // the default parser: tapes and buffers only grow, and the chunk roots are
+  // converted before any Ruby code can run another threaded parse.
+  struct RClass *json_mod = opts.state->json_mod;
+  mrb_value pool = mrb_iv_get(mrb, mrb_obj_value(json_mod), MRB_SYM(threaded_parsers));
+  if (mrb_nil_p(pool)) {
+    pool = mrb_ary_new_capa(mrb, static_cast<mrb_int>(n * 2));
+    mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(threaded_parsers), pool);
+  }
+  if (RARRAY_LEN(pool) < static_cast<mrb_int>(n * 2)) {
+    struct RClass *dom_parser_cls = mrb_class_get_under_id(mrb, json_mod, MRB_SYM(DomParser));
+    while (RARRAY_LEN(pool) < static_cast<mrb_int>(n * 2)) {
+      mrb_ary_push(mrb, pool, mrb_obj_new(mrb, dom_parser_cls, 0, NULL));
+      mrb_ary_push(mrb, pool, mrb_str_new(mrb, NULL, 0));
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    mrb_value buf_obj = RARRAY_PTR(pool)[i * 2 + 1];
+    const mrb_int need = static_cast<mrb_int>(chunks[i].src.size() + 2 + SIMDJSON_PADDING);
+    if (RSTRING_LEN(buf_obj) < need) mrb_str_resize(mrb, buf_obj, need);
+    chunks[i].parser = mrb_cpp_get<dom::parser>(mrb, RARRAY_PTR(pool)[i * 2]);
+    chunks[i].buf = RSTRING_PTR(buf_obj);
+  }
+  run_workers(n, [&chunks](size_t i) { parse_chunk(chunks[i]); });
+
+  // big integers need the OnDemand fallback of the serial path
+  for (size_t i = 0; i < n; ++i)
+    if (unlikely(chunks[i].code != SUCCESS)) return mrb_undef_value();
+  // every chunk root knows its element count, so the result is sized once
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) total += chunks[i].root.get_array().value_unsafe().size();
+  const mrb_int capa = static_cast<mrb_int>(total);
+  mrb_value result = mrb_ary_new_capa(mrb, capa);
+  mrb_gc_protect(mrb, result);
+  int arena = mrb_gc_arena_save(mrb);
+  for (size_t i = 0; i < n; ++i) {
+    for (dom::element el : chunks[i].root.get_array().value_unsafe()) {
+      json_ary_append(mrb, result, capa, convert_element(mrb, el, opts));
+      mrb_gc_arena_restore(mrb, arena);
+    }
+  }
+  return result;
+}
+
+// JSON.parse(str, lazy: true) parses into a JSON::Tape that owns its own
+// dom::document, so later parses on the shared parser cannot clobber it.
+// JSON::Element is a view into that tape: containers stay Elements, scalars
+// convert on access, so only the parts that are touched allocate.
+struct LazyElement {
+  LazyElement(dom::element el, mrb_bool symbolize_names) : el(el), symbolize_names(symbolize_names) {}
+  dom::element el;
+  mrb_bool symbolize_names;
+};
+
+MRB_CPP_DEFINE_TYPE(dom::document, dom_document);
+MRB_CPP_DEFINE_TYPE(LazyElement, lazy_element);
+
+static mrb_value lazy_element_wrap(mrb_state *mrb, mrb_value tape, dom::element el, mrb_bool symbolize_names) {
+  if (!el.is_array() && !el.is_object())
+    return convert_element(mrb, el, ConvertOptions{symbolize_names});
+  mrb_value obj = mrb_obj_new(mrb, json_state(mrb)->element_cls, 0, NULL);
+  mrb_iv_set(mrb, obj, MRB_SYM(tape), tape);
+  mrb_cpp_new<LazyElement>(mrb, obj, el, symbolize_names);
+  return obj;
+}
+
+static mrb_value json_parse_lazy_element(mrb_state *mrb, dom::parser *parser, mrb_value str, mrb_bool symbolize_names) {
+  struct RClass *tape_cls = mrb_class_get_under_id(mrb, json_state(mrb)->json_mod, MRB_SYM(Tape));
+  mrb_value tape = mrb_obj_new(mrb, tape_cls, 0, NULL);
+  dom::document *doc = mrb_cpp_new<dom::document>(mrb, tape);
+  padded_string jsonbuffer;
+  auto view = simdjson_safe_view_from_mrb_string(mrb, str, jsonbuffer);
+  dom::element root;
+  auto code = parser->parse_into_document(*doc, view.data(), view.length(), false).get(root);
+  if (likely(code == SUCCESS)) {
+    JSON_STAT_ADD(mrb, documents, 1);
+    return lazy_element_wrap(mrb, tape, root, symbolize_names);
+  }
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+static LazyElement *mrb_json_element_get(mrb_state *mrb, mrb_value self) {
+  return mrb_cpp_get<LazyElement>(mrb, self);
+}
+
+static mrb_value lazy_element_child(mrb_state *mrb, mrb_value self, const LazyElement *e, dom::element child) {
+  return lazy_element_wrap(mrb, mrb_iv_get(mrb, self, MRB_SYM(tape)), child, e->symbolize_names);
+}
+
+// Array index (negative counts from the end) or object key; misses return
+// nil like Array#[] and Hash#[].
+static mrb_value mrb_json_element_aref(mrb_state *mrb, mrb_value self) {
+  mrb_value key;
+  mrb_get_args(mrb, "o", &key);
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  dom::element child;
+  error_code code;
+  if (e->el.is_array()) {
+    dom::array arr = e->el.get_array().value_unsafe();
+    mrb_int idx = mrb_integer(mrb_ensure_int_type(mrb, key));
+    if (idx < 0) idx += static_cast<mrb_int>(arr.size());
+    if (idx < 0) return mrb_nil_value();
+    code = arr.at(static_cast<size_t>(idx)).get(child);
+    if (code == INDEX_OUT_OF_BOUNDS) return mrb_nil_value();
+  } else {
+    if (mrb_symbol_p(key)) key = mrb_sym_str(mrb, mrb_symbol(key));
+    mrb_ensure_string_type(mrb, key);
+    code = e->el.get_object().value_unsafe().at_key(std::string_view(RSTRING_PTR(key), RSTRING_LEN(key))).get(child);
+    if (code == NO_SUCH_FIELD) return mrb_nil_value();
+  }
+  if (likely(code == SUCCESS)) return lazy_element_child(mrb, self, e, child);
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+static mrb_value mrb_json_element_at_pointer(mrb_state *mrb, mrb_value self) {
+  const char *ptr; mrb_int len;
+  mrb_get_args(mrb, "s", &ptr, &len);
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  dom::element child;
+  auto code = e->el.at_pointer(std::string_view(ptr, len)).get(child);
+  if (likely(code == SUCCESS)) return lazy_element_child(mrb, self, e, child);
   raise_simdjson_error(mrb, code);
   return mrb_undef_value();
 }
 
+static mrb_value mrb_json_element_size(mrb_state *mrb, mrb_value self) {
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  if (e->el.is_array()) return mrb_convert_number(mrb, e->el.get_array().value_unsafe().size());
+  return mrb_convert_number(mrb, e->el.get_object().value_unsafe().size());
+}
+
+static mrb_value mrb_json_element_type(mrb_state *mrb, mrb_value self) {
+  return mrb_symbol_value(mrb_json_element_get(mrb, self)->el.is_array() ? MRB_SYM(array) : MRB_SYM(object));
+}
+
+// Arrays yield each value, objects yield key and value.
+static mrb_value mrb_json_element_each(mrb_state *mrb, mrb_value self) {
+  mrb_value block = mrb_nil_value();
+  mrb_get_args(mrb, "&", &block);
+  if (!mrb_proc_p(block)) return mrb_funcall_id(mrb, self, MRB_SYM(to_enum), 1, mrb_symbol_value(MRB_SYM(each)));
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  const ConvertOptions opts{e->symbolize_names};
+  int arena = mrb_gc_arena_save(mrb);
+  if (e->el.is_array()) {
+    for (dom::element item : e->el.get_array().value_unsafe()) {
+      mrb_yield(mrb, block, lazy_element_child(mrb, self, e, item));
+      mrb_gc_arena_restore(mrb, arena);
+    }
+  } else {
+    for (dom::key_value_pair kv : e->el.get_object().value_unsafe()) {
+      mrb_value argv[] = {convert_key(mrb, kv.key, opts), lazy_element_child(mrb, self, e, kv.value)};
+      mrb_yield_argv(mrb, block, 2, argv);
+      mrb_gc_arena_restore(mrb, arena);
+    }
+  }
+  return self;
+}
+
+static mrb_value mrb_json_element_keys(mrb_state *mrb, mrb_value self) {
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  dom::object obj;
+  auto code = e->el.get_object().get(obj);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  const ConvertOptions opts{e->symbolize_names};
+  mrb_value keys = mrb_ary_new_capa(mrb, obj.size());
+  int arena = mrb_gc_arena_save(mrb);
+  for (dom::key_value_pair kv : obj) {
+    mrb_ary_push(mrb, keys, convert_key(mrb, kv.key, opts));
+    mrb_gc_arena_restore(mrb, arena);
+  }
+  return keys;
+}
+
+static mrb_value mrb_json_element_has_key(mrb_state *mrb, mrb_value self) {
+  mrb_value key;
+  mrb_get_args(mrb, "o", &key);
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  if (!e->el.is_object()) return mrb_false_value();
+  if (mrb_symbol_p(key)) key = mrb_sym_str(mrb, mrb_symbol(key));
+  mrb_ensure_string_type(mrb, key);
+  dom::element child;
+  auto code = e->el.get_object().value_unsafe().at_key(std::string_view(RSTRING_PTR(key), RSTRING_LEN(key))).get(child);
+  return mrb_bool_value(code == SUCCESS);
+}
+
+static mrb_value mrb_json_element_to_a(mrb_state *mrb, mrb_value self) {
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  return convert_array(mrb, e->el, ConvertOptions{e->symbolize_names});
+}
+
+static mrb_value mrb_json_element_to_h(mrb_state *mrb, mrb_value self) {
+  LazyElement *e = mrb_json_element_get(mrb, self);
+  return convert_object(mrb, e->el, ConvertOptions{e->symbolize_names});
+}
+
+// ============================================================================
+// Tape files — DomParser#dump_tape / JSON.load_tape. The file is a header,
+// the tape words and the used part of the string buffer, all in host byte
+// order; the header's byte-order word rejects files from other hosts.
+// dom::document owns both buffers, so loading reads the file straight into
+// them: one sequential read instead of stage 1 and 2. The file is not
+// trusted: json_tape_valid walks it once before any element is built.
+// ============================================================================
+
+struct TapeFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t tape_words;
+  uint64_t string_bytes;
+};
+
+static constexpr char JSON_TAPE_MAGIC[8] = {'M', 'R', 'B', 'J', 'T', 'A', 'P', 'E'};
+static constexpr uint32_t JSON_TAPE_VERSION = 1;
+static constexpr uint32_t JSON_TAPE_BYTE_ORDER = 0x01020304;
+
+static inline char tape_word_type(uint64_t w) { return static_cast<char>(w >> 56); }
+static inline uint64_t tape_word_payload(uint64_t w) { return w & internal::JSON_VALUE_MASK; }
+
+// The tape does not record how much of the string buffer is in use, so take
+// the end of the furthest string (4-byte length, bytes, NUL).
+static size_t json_tape_string_bytes(const dom::document &doc, size_t words) {
+  size_t used = 0;
+  for (size_t i = 1; i + 1 < words; ++i) {
+    const uint64_t w = doc.tape[i];
+    switch (tape_word_type(w)) {
+    case '"': {
+      const size_t off = static_cast<size_t>(tape_word_payload(w));
+      uint32_t len;
+      std::memcpy(&len, doc.string_buf.get() + off, sizeof(len));
+      used = std::max(used, off + sizeof(len) + len + 1);
+    } break;
+    case 'l': case 'u': case 'd': ++i; break;
+    default: break;
+    }
+  }
+  return used;
+}
+
+// Every scope has to close where its opener points, with the count the
+// opener claims; object members have to start with a key; strings have to
+// lie inside the buffer, end in NUL and be UTF-8; and there is one root.
+// Nesting is capped at max_depth because the converters recurse per level.
+static bool json_tape_valid(const dom::document &doc, size_t words, size_t string_bytes, size_t max_depth) {
+  const uint64_t *tape = doc.tape.get();
+  const uint8_t *strings = doc.string_buf.get();
+  if (words < 3 || tape_word_type(tape[0]) != 'r' || tape_word_payload(tape[0]) != words - 1) return false;
+  if (tape_word_type(tape[words - 1]) != 'r' || tape_word_payload(tape[words - 1]) != 0) return false;
+  struct Scope { size_t start; size_t children; bool object; };
+  std::vector<Scope> scopes;
+  size_t roots = 0;
+  for (size_t i = 1; i < words - 1; ++i) {
+    const uint64_t w = tape[i];
+    const char type = tape_word_type(w);
+    if (type == ']' || type == '}') {
+      if (scopes.empty()) return false;
+      const Scope s = scopes.back();
+      scopes.pop_back();
+      if (s.object != (type == '}') || tape_word_payload(w) != s.start) return false;
+      if (s.object && (s.children & 1)) return false;
+      const uint64_t open = tape[s.start];
+      const size_t count = s.object ? s.children / 2 : s.children;
+      if (static_cast<uint32_t>(open) != i + 1 ||
+          ((open >> 32) & internal::JSON_COUNT_MASK) != std::min<size_t>(count, internal::JSON_COUNT_MASK))
+        return false;
+    } else {
+      const bool key = !scopes.empty() && scopes.back().object && !(scopes.back().children & 1);
+      if (key && type != '"') return false;
+      switch (type) {
+      case '[': case '{':
+        if (scopes.size() >= max_depth) return false;
+        scopes.push_back(Scope{i, 0, type == '{'});
+        continue;
+      case '"': {
+        const uint64_t off = tape_word_payload(w);
+        uint32_t len;
+        if (off > string_bytes || string_bytes - off < sizeof(len) + 1) return false;
+        std::memcpy(&len, strings + off, sizeof(len));
+        if (string_bytes - off - sizeof(len) - 1 < len || strings[off + sizeof(len) + len] != 0) return false;
+        if (!simdjson::validate_utf8(reinterpret_cast<const char *>(strings + off + sizeof(len)), len)) return false;
+      } break;
+      case 'l': case 'u': case 'd':
+        if (++i >= words - 1) return false;
+        break;
+      case 't': case 'f': case 'n':
+        break;
+      default:
+        return false;
+      }
+    }
+    if (scopes.empty()) ++roots; else ++scopes.back().children;
+  }
+  return scopes.empty() && roots == 1;
+}
+
+// fstat rather than ftell, whose long is 32 bits on LLP64 hosts.
+static bool json_file_size(std::FILE *f, uint64_t &size) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_fstat64(_fileno(f), &st) != 0 || st.st_size < 0) return false;
+#else
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0 || st.st_size < 0) return false;
+#endif
+  size = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+// Returns 0, an errno value, or -1 when the file is not a tape file.
+static int json_tape_read(const char *path, dom::document &doc, size_t &words, size_t &string_bytes) {
+  std::FILE *f = std::fopen(path, "rb");
+  if (!f) return errno;
+  int rc = -1;
+  TapeFileHeader h;
+  uint64_t size = 0;
+  errno = 0;
+  if (!json_file_size(f, size)) {
+    rc = errno ? errno : EIO;
+  } else if (size >= sizeof(h) && std::fread(&h, sizeof(h), 1, f) == 1 &&
+      std::memcmp(h.magic, JSON_TAPE_MAGIC, sizeof(h.magic)) == 0 && h.version == JSON_TAPE_VERSION &&
+      h.byte_order == JSON_TAPE_BYTE_ORDER && h.tape_words >= 3 &&
+      h.tape_words <= (size - sizeof(h)) / sizeof(uint64_t) &&
+      h.string_bytes == size - sizeof(h) - h.tape_words * sizeof(uint64_t) &&
+      h.tape_words <= SIZE_MAX / sizeof(uint64_t) && h.string_bytes <= SIZE_MAX - SIMDJSON_PADDING) {
+    words = static_cast<size_t>(h.tape_words);
+    string_bytes = static_cast<size_t>(h.string_bytes);
+    doc.tape.reset(new (std::nothrow) uint64_t[words]);
+    doc.string_buf.reset(new (std::nothrow) uint8_t[string_bytes + SIMDJSON_PADDING]());
+    if (!doc.tape || !doc.string_buf) rc = ENOMEM;
+    else if (std::fread(doc.tape.get(), sizeof(uint64_t), words, f) != words ||
+             std::fread(doc.string_buf.get(), 1, string_bytes, f) != string_bytes)
+      rc = std::ferror(f) ? EIO : -1;
+    else rc = 0;
+  } else if (std::ferror(f)) {
+    rc = EIO;
+  }
+  std::fclose(f);
+  return rc;
+}
+
+// Writes the document of the parser's last successful parse. A failed parse
+// clears the root word (json_dom_parse_convert), so it cannot be dumped.
+static mrb_value mrb_dom_parser_dump_tape(mrb_state *mrb, mrb_value self) {
+  mrb_value path;
+  mrb_get_args(mrb, "S", &path);
+  const char *cpath = mrb_string_value_cstr(mrb, &path);
+  const dom::document &doc = mrb_cpp_get<dom::parser>(mrb, self)->doc;
+  if (unlikely(!doc.tape || tape_word_type(doc.tape[0]) != 'r'))
+    mrb_raise(mrb, E_JSON_UNINITIALIZED_ERROR, "no parsed document to dump");
+  TapeFileHeader h{};
+  std::memcpy(h.magic, JSON_TAPE_MAGIC, sizeof(h.magic));
+  h.version = JSON_TAPE_VERSION;
+  h.byte_order = JSON_TAPE_BYTE_ORDER;
+  const size_t words = static_cast<size_t>(tape_word_payload(doc.tape[0])) + 1;
+  const size_t string_bytes = json_tape_string_bytes(doc, words);
+  h.tape_words = words;
+  h.string_bytes = string_bytes;
+  std::FILE *f = std::fopen(cpath, "wb");
+  if (unlikely(!f)) mrb_sys_fail(mrb, cpath);
+  bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+            std::fwrite(doc.tape.get(), sizeof(uint64_t), words, f) == words &&
+            std::fwrite(doc.string_buf.get(), 1, string_bytes, f) == string_bytes;
+  int e = ok ? 0 : errno;
+  if (std::fclose(f) != 0 && ok) { ok = false; e = errno; }
+  if (unlikely(!ok)) { errno = e; mrb_sys_fail(mrb, cpath); }
+  return self;
+}
+
+static mrb_value mrb_json_load_tape(mrb_state *mrb, mrb_value self) {
+  mrb_value path;
+  mrb_value kw_values[4] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(symbolize_names), MRB_SYM(cache_keys), MRB_SYM(lazy), MRB_SYM(max_depth)};
+  mrb_kwargs kwargs = {4, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S:", &path, &kwargs);
+  const char *cpath = mrb_string_value_cstr(mrb, &path);
+  mrb_int max_depth = mrb_undef_p(kw_values[3]) ? DEFAULT_MAX_DEPTH : mrb_as_int(mrb, kw_values[3]);
+  if (unlikely(max_depth < 1)) mrb_raise(mrb, E_ARGUMENT_ERROR, "max_depth must be positive");
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  convert_options_from_kwargs(mrb, kw_values[0], kw_values[1], opts, key_cache);
+  mrb_value tape = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, mrb_class_ptr(self), MRB_SYM(Tape)), 0, NULL);
+  mrb_gc_protect(mrb, tape);
+  dom::document *doc = mrb_cpp_new<dom::document>(mrb, tape);
+  size_t words = 0, string_bytes = 0;
+  int e = json_tape_read(cpath, *doc, words, string_bytes);
+  if (unlikely(e > 0)) { errno = e; mrb_sys_fail(mrb, cpath); }
+  if (unlikely(e < 0 || !json_tape_valid(*doc, words, string_bytes, static_cast<size_t>(max_depth))))
+    mrb_raisef(mrb, E_JSON_TAPE_ERROR, "%s is not a valid JSON tape file", cpath);
+  JSON_STAT_ADD(mrb, documents, 1);
+  if (kwarg_test(kw_values[2])) return lazy_element_wrap(mrb, tape, doc->root(), opts.symbolize_names);
+  return convert_element(mrb, doc->root(), opts);
+}
+
+static BigintMode bigint_mode_from_kwarg(mrb_state *mrb, mrb_value mode) {
+  if (mrb_undef_p(mode) || mrb_nil_p(mode)) return BIGINT_AS_INTEGER;
+  if (mrb_symbol_p(mode)) {
+    switch (mrb_symbol(mode)) {
+      case MRB_SYM(integer): return BIGINT_AS_INTEGER;
+      case MRB_SYM(string):  return BIGINT_AS_STRING;
+      case MRB_SYM(raw):     return BIGINT_AS_RAW;
+      default: break;
+    }
+  }
+  mrb_raise(mrb, E_ARGUMENT_ERROR, "bigint: must be :integer, :string or :raw");
+  return BIGINT_AS_INTEGER;
+}
+
 static mrb_value mrb_json_parse_m(mrb_state *mrb, mrb_value self) {
   mrb_value str, dom_parser = mrb_undef_value();
-  mrb_value kw_values[1] = {mrb_undef_value()};
-  mrb_sym kw_names[] = {MRB_SYM(symbolize_names)};
-  mrb_kwargs kwargs = {1, 0, kw_names, kw_values, NULL};
+  mrb_value kw_values[6] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(symbolize_names), MRB_SYM(cache_keys), MRB_SYM(threads), MRB_SYM(lazy), MRB_SYM(shared_strings), MRB_SYM(bigint)};
+  mrb_kwargs kwargs = {6, 0, kw_names, kw_values, NULL};
   mrb_get_args(mrb, "S|o:", &str, &dom_parser, &kwargs);
-  mrb_bool symbolize_names = FALSE;
-  if (!mrb_undef_p(kw_values[0])) symbolize_names = mrb_bool(kw_values[0]);
   if (mrb_undef_p(dom_parser))
-    dom_parser = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, mrb_class_ptr(self), MRB_SYM(DomParser)), 0, NULL);
+    dom_parser = json_default_dom_parser(mrb, mrb_class_ptr(self));
   dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, dom_parser);
+  if (kwarg_test(kw_values[3])) {
+    // Elements convert on access and keep only symbolize_names.
+    if (unlikely(kwarg_test(kw_values[1]) || kwarg_test(kw_values[2]) || kwarg_test(kw_values[4]) || kwarg_test(kw_values[5])))
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "lazy: cannot be combined with cache_keys:, threads:, shared_strings: or bigint:");
+    return json_parse_lazy_element(mrb, parser, str, kwarg_test(kw_values[0]));
+  }
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  convert_options_from_kwargs(mrb, kw_values[0], kw_values[1], opts, key_cache);
+  opts.bigint = bigint_mode_from_kwarg(mrb, kw_values[5]);
+  const size_t threads = threads_from_kwarg(mrb, kw_values[2]);
+  // the workers parse copies of the input, which leaves nothing to share
+  if (unlikely(threads > 1 && kwarg_test(kw_values[4])))
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "threads: cannot be combined with shared_strings:");
   padded_string jsonbuffer;
   auto view = simdjson_safe_view_from_mrb_string(mrb, str, jsonbuffer);
-  dom::element element;
-  auto code = parser->parse(view).get(element);
-  if (likely(code == SUCCESS)) return convert_element(mrb, element, symbolize_names);
-  raise_simdjson_error(mrb, code);
-  return mrb_undef_value();
+  if (threads > 1) {
+    mrb_value result = json_parse_array_threaded(mrb, view, threads, opts);
+    if (!mrb_undef_p(result)) { JSON_STAT_ADD(mrb, documents, 1); return result; }
+  }
+  // Sharing needs the view to be the String's own frozen buffer, which is
+  // what zero_copy_parsing (or an in-place pad) produced; copies fall back.
+  if (kwarg_test(kw_values[4]) && mrb_frozen_p(mrb_obj_ptr(str)) && view.data() == RSTRING_PTR(str)) {
+    opts.shared_base = RSTRING_PTR(str);
+    opts.shared_source = str;
+    return json_ondemand_parse_convert(mrb, view.data(), view.length(), opts);
+  }
+  return json_dom_parse_convert(mrb, parser, view.data(), view.length(), opts);
 }
 
 MRB_CPP_DEFINE_TYPE(ondemand::parser, ondemand_parser);
@@ -254,16 +1203,19 @@ MRB_CPP_DEFINE_TYPE(padded_string_view, padded_string_view);
 MRB_CPP_DEFINE_TYPE(ondemand::document, ondemand_document);
 
 static mrb_value make_padded_string_view_from_ruby_str(mrb_state *mrb, mrb_value str) {
-  struct RClass *json_mod = mrb_module_get_id(mrb, MRB_SYM(JSON));
-  mrb_value zero_copy = mrb_iv_get(mrb, mrb_obj_value(json_mod), MRB_IVSYM(zero_copy_parsing));
+  JsonState *state = json_state(mrb);
+  struct RClass *json_mod = state->json_mod;
   mrb_int len = RSTRING_LEN(str);
   mrb_value argv[] = {mrb_undef_value(), mrb_undef_value()};
   mrb_int argc = 0;
-  if (mrb_test(zero_copy) && likely(!need_allocation(RSTRING_PTR(str), len, RSTRING_CAPA(str)))) {
+  JSON_STAT_ADD(mrb, bytes_parsed, len);
+  if (state->zero_copy_parsing && likely(!need_allocation(RSTRING_PTR(str), len, RSTRING_CAPA(str)))) {
+    JSON_STAT_ADD(mrb, zero_copy_hits, 1);
     argv[0] = mrb_obj_freeze(mrb, str);
     argv[1] = mrb_convert_number(mrb, len + SIMDJSON_PADDING);
     argc = 2;
   } else if (mrb_frozen_p(mrb_obj_ptr(str))) {
+    JSON_STAT_ADD(mrb, padding_copies, 1);
     argv[0] = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedString)), 1, &str);
     argc = 1;
   } else if (unlikely(len > SIZE_MAX - SIMDJSON_PADDING)) {
@@ -271,6 +1223,7 @@ static mrb_value make_padded_string_view_from_ruby_str(mrb_state *mrb, mrb_value
   } else {
     mrb_int required = len + SIMDJSON_PADDING;
     if (RSTRING_CAPA(str) < required) {
+      JSON_STAT_ADD(mrb, padding_copies, 1);
       str = mrb_str_resize(mrb, str, required);
       str = mrb_obj_freeze(mrb, str);
       RSTR_SET_LEN(RSTRING(str), len);
@@ -302,7 +1255,7 @@ static mrb_value mrb_ondemand_parser_iterate(mrb_state *mrb, mrb_value self) {
   mrb_get_args(mrb, "S", &arg);
   mrb_value view_obj = make_padded_string_view_from_ruby_str(mrb, arg);
   mrb_gc_protect(mrb, view_obj);
-  struct RClass *json_mod = mrb_module_get_id(mrb, MRB_SYM(JSON));
+  struct RClass *json_mod = json_state(mrb)->json_mod;
   mrb_value args[] = {view_obj, self};
   return mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
 }
@@ -320,7 +1273,7 @@ static mrb_value mrb_padded_string_s_load(mrb_state *mrb, mrb_value self) {
   mrb_get_args(mrb, "S", &path);
   std::string_view sv(RSTRING_PTR(path), RSTRING_LEN(path));
   padded_string loaded = padded_string::load(sv);
-  struct RClass *json_mod = mrb_module_get_id(mrb, MRB_SYM(JSON));
+  struct RClass *json_mod = json_state(mrb)->json_mod;
   mrb_value ps_obj = mrb_obj_new(mrb, mrb_class_ptr(self), 0, NULL);
   mrb_gc_protect(mrb, ps_obj);
   *mrb_cpp_get<padded_string>(mrb, ps_obj) = std::move(loaded);
@@ -331,32 +1284,134 @@ static mrb_value mrb_padded_string_s_load(mrb_state *mrb, mrb_value self) {
   return view_obj;
 }
 
-static mrb_value mrb_padded_string_view_initialize(mrb_state *mrb, mrb_value self) {
-  mrb_value buf = mrb_undef_value();
-  mrb_int capa = 0;
-  mrb_int argc = mrb_get_args(mrb, "|oi", &buf, &capa);
-  if (argc == 0) { mrb_cpp_new<padded_string_view>(mrb, self); return self; }
-  if (mrb_string_p(buf))
-    mrb_cpp_new<padded_string_view>(mrb, self, RSTRING_PTR(buf), RSTRING_LEN(buf), argc == 1 ? RSTRING_CAPA(buf) : capa);
-  else
-    mrb_cpp_new<padded_string_view>(mrb, self, *mrb_cpp_get<padded_string>(mrb, buf));
-  mrb_iv_set(mrb, self, MRB_SYM(buf), buf);
-  return self;
-}
+// ============================================================================
+// JSON::MappedString — a read-only mmap of a file, padded for simdjson.
+// A PROT_READ anonymous mapping of size + SIMDJSON_PADDING (rounded up to
+// pages) is reserved first and the file is mapped over its start, so the
+// padding is always readable zeros: either the zero-filled tail of the
+// file's last page or the anonymous pages behind it. Nothing is copied.
+// Windows has no MAP_FIXED equivalent that is safe to use here, so it falls
+// back to padded_string::load.
+// ============================================================================
 
-static mrb_value mrb_ondemand_document_initialize(mrb_state *mrb, mrb_value self) {
-  mrb_value view_obj, parser_obj = mrb_undef_value();
-  mrb_get_args(mrb, "o|o", &view_obj, &parser_obj);
-  auto *view = mrb_cpp_get<padded_string_view>(mrb, view_obj);
-  struct RClass *json_mod = mrb_module_get_id(mrb, MRB_SYM(JSON));
-  if (mrb_undef_p(parser_obj))
-    parser_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser)), 0, NULL);
-  mrb_gc_protect(mrb, parser_obj);
-  auto *parser = mrb_cpp_get<ondemand::parser>(mrb, parser_obj);
-  auto *doc = mrb_cpp_new<ondemand::document>(mrb, self);
-  auto code = parser->iterate(*view).get(*doc);
-  if (likely(code == SUCCESS)) {
-    mrb_iv_set(mrb, self, MRB_SYM(view), view_obj);
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { release(); }
+
+  // Returns 0 or an errno value.
+  int map(const char *path) {
+    release();
+#ifdef _WIN32
+    auto res = padded_string::load(path);
+    if (res.error() != SUCCESS) return EIO;
+    fallback = std::move(res.value());
+    ptr = fallback.data();
+    len = fallback.size();
+    return 0;
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { int e = errno; close(fd); return e; }
+    if (!S_ISREG(st.st_mode)) { close(fd); return EINVAL; }
+    const size_t size = static_cast<size_t>(st.st_size);
+    const size_t page = static_cast<size_t>(pagesize);
+    if (size > SIZE_MAX - SIMDJSON_PADDING - page) { close(fd); return EFBIG; }
+    const size_t total = (size + SIMDJSON_PADDING + page - 1) / page * page;
+    void *region = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) { int e = errno; close(fd); return e; }
+    if (size > 0 && mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int e = errno; munmap(region, total); close(fd); return e;
+    }
+    close(fd);
+#ifdef MADV_SEQUENTIAL
+    if (size > 0) madvise(region, size, MADV_SEQUENTIAL);
+#endif
+    base = region;
+    span = total;
+    ptr = static_cast<const char *>(region);
+    len = size;
+    return 0;
+#endif
+  }
+
+  const char *data() const { return ptr; }
+  size_t size() const { return len; }
+
+private:
+  void release() {
+#ifdef _WIN32
+    fallback = padded_string();
+#else
+    if (base) munmap(base, span);
+    base = nullptr;
+    span = 0;
+#endif
+    ptr = nullptr;
+    len = 0;
+  }
+
+#ifdef _WIN32
+  padded_string fallback;
+#else
+  void *base = nullptr;
+  size_t span = 0;
+#endif
+  const char *ptr = nullptr;
+  size_t len = 0;
+};
+
+MRB_CPP_DEFINE_TYPE(MappedFile, mapped_file);
+
+static mrb_value mrb_mapped_string_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value path;
+  mrb_get_args(mrb, "S", &path);
+  const char *cpath = mrb_string_value_cstr(mrb, &path);
+  auto *mapped = mrb_cpp_new<MappedFile>(mrb, self);
+  int e = mapped->map(cpath);
+  if (unlikely(e != 0)) { errno = e; mrb_sys_fail(mrb, cpath); }
+  return self;
+}
+
+static mrb_value mrb_mapped_string_bytesize(mrb_state *mrb, mrb_value self) {
+  return mrb_convert_number(mrb, mrb_cpp_get<MappedFile>(mrb, self)->size());
+}
+
+static mrb_value mrb_padded_string_view_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value buf = mrb_undef_value();
+  mrb_int capa = 0;
+  mrb_int argc = mrb_get_args(mrb, "|oi", &buf, &capa);
+  if (argc == 0) { mrb_cpp_new<padded_string_view>(mrb, self); return self; }
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  if (mrb_string_p(buf)) {
+    mrb_cpp_new<padded_string_view>(mrb, self, RSTRING_PTR(buf), RSTRING_LEN(buf), argc == 1 ? RSTRING_CAPA(buf) : capa);
+  } else if (mrb_obj_is_kind_of(mrb, buf, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(MappedString)))) {
+    auto *mapped = mrb_cpp_get<MappedFile>(mrb, buf);
+    mrb_cpp_new<padded_string_view>(mrb, self, mapped->data(), mapped->size(), mapped->size() + SIMDJSON_PADDING);
+  } else {
+    mrb_cpp_new<padded_string_view>(mrb, self, *mrb_cpp_get<padded_string>(mrb, buf));
+  }
+  mrb_iv_set(mrb, self, MRB_SYM(buf), buf);
+  return self;
+}
+
+static mrb_value mrb_ondemand_document_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value view_obj, parser_obj = mrb_undef_value();
+  mrb_get_args(mrb, "o|o", &view_obj, &parser_obj);
+  auto *view = mrb_cpp_get<padded_string_view>(mrb, view_obj);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  if (mrb_undef_p(parser_obj))
+    parser_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser)), 0, NULL);
+  mrb_gc_protect(mrb, parser_obj);
+  auto *parser = mrb_cpp_get<ondemand::parser>(mrb, parser_obj);
+  auto *doc = mrb_cpp_new<ondemand::document>(mrb, self);
+  auto code = parser->iterate(*view).get(*doc);
+  if (likely(code == SUCCESS)) {
+    JSON_STAT_ADD(mrb, documents, 1);
+    mrb_iv_set(mrb, self, MRB_SYM(view), view_obj);
     mrb_iv_set(mrb, self, MRB_SYM(parser), parser_obj);
     mrb_iv_set(mrb, self, MRB_SYM(cache), mrb_hash_new(mrb));
     return self;
@@ -367,45 +1422,72 @@ static mrb_value mrb_ondemand_document_initialize(mrb_state *mrb, mrb_value self
 
 static mrb_value mrb_json_parse_lazy(mrb_state *mrb, mrb_value self) {
   mrb_value str, parser_obj = mrb_undef_value();
-  mrb_get_args(mrb, "S|o", &str, &parser_obj);
+  mrb_value kw_values[1] = {mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {1, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S|o:", &str, &parser_obj, &kwargs);
   struct RClass *json_mod = mrb_class_ptr(self);
   mrb_value view_obj = make_padded_string_view_from_ruby_str(mrb, str);
   if (mrb_undef_p(parser_obj))
     parser_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser)), 0, NULL);
   mrb_gc_protect(mrb, parser_obj);
   mrb_value args[2] = {view_obj, parser_obj};
-  return mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
+  mrb_value doc = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
+  mrb_iv_set(mrb, doc, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(kw_values[0])));
+  return doc;
 }
 
 static mrb_value mrb_json_load_lazy(mrb_state *mrb, mrb_value self) {
   mrb_value path, parser_obj = mrb_undef_value();
-  mrb_get_args(mrb, "S|o", &path, &parser_obj);
+  mrb_value kw_values[2] = {mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(cache_keys), MRB_SYM(mmap)};
+  mrb_kwargs kwargs = {2, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S|o:", &path, &parser_obj, &kwargs);
   struct RClass *json_mod = mrb_class_ptr(self);
-  mrb_value view_obj = mrb_funcall_argv(mrb,
-    mrb_obj_value(mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedString))),
-    MRB_SYM(load), 1, &path);
+  mrb_value view_obj;
+  if (kwarg_test(kw_values[1])) {
+    mrb_value mapped = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(MappedString)), 1, &path);
+    mrb_gc_protect(mrb, mapped);
+    view_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedStringView)), 1, &mapped);
+  } else {
+    view_obj = mrb_funcall_argv(mrb,
+      mrb_obj_value(mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedString))),
+      MRB_SYM(load), 1, &path);
+  }
   mrb_gc_protect(mrb, view_obj);
   if (mrb_undef_p(parser_obj))
     parser_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser)), 0, NULL);
   mrb_gc_protect(mrb, parser_obj);
   mrb_value args[] = {view_obj, parser_obj};
-  return mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
+  mrb_value doc = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
+  mrb_iv_set(mrb, doc, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(kw_values[0])));
+  return doc;
 }
 
-static mrb_value convert_ondemand_value_to_mrb(mrb_state* mrb, ondemand::value& v);
+static mrb_value convert_ondemand_value_to_mrb(mrb_state* mrb, ondemand::value& v, const ConvertOptions &opts, unsigned depth = 0);
+
+// Counting a container walks every structural inside it, so pre-sizing at
+// each level would re-walk nested subtrees once per enclosing level. Only
+// the outermost level of a conversion is counted; inner containers grow
+// through mrb_ary_push / mrb_hash_set like any Array or Hash.
+#define JSON_ONDEMAND_PRESIZE_DEPTH 1
 
-static mrb_value convert_ondemand_array(mrb_state* mrb, ondemand::value &array) {
+static mrb_value convert_ondemand_array(mrb_state* mrb, ondemand::value &array, const ConvertOptions &opts, unsigned depth) {
   ondemand::array arr;
   auto code = array.get_array().get(arr);
-  bool is_empty;
-  if (likely(code == SUCCESS)) code = arr.is_empty().get(is_empty);
+  // Counting walks the structural index only (no values are parsed) and
+  // rewinds, so the outer array is allocated once at its final size.
+  size_t count = 0;
+  const bool presize = depth < JSON_ONDEMAND_PRESIZE_DEPTH;
+  if (likely(code == SUCCESS) && presize) code = arr.count_elements().get(count);
   if (likely(code == SUCCESS)) {
-    if (is_empty) return mrb_ary_new(mrb);
-    mrb_value ary = mrb_ary_new(mrb);
+    if (presize && count == 0) return mrb_ary_new(mrb);
+    const mrb_int capa = static_cast<mrb_int>(count);
+    mrb_value ary = mrb_ary_new_capa(mrb, capa);
     mrb_gc_protect(mrb, ary);
     int arena = mrb_gc_arena_save(mrb);
     for (ondemand::value val : arr) {
-      mrb_ary_push(mrb, ary, convert_ondemand_value_to_mrb(mrb, val));
+      json_ary_append(mrb, ary, capa, convert_ondemand_value_to_mrb(mrb, val, opts, depth + 1));
       mrb_gc_arena_restore(mrb, arena);
     }
     return ary;
@@ -414,25 +1496,26 @@ static mrb_value convert_ondemand_array(mrb_state* mrb, ondemand::value &array)
   return mrb_undef_value();
 }
 
-static mrb_value convert_ondemand_object(mrb_state* mrb, ondemand::value &object) {
+static mrb_value convert_ondemand_object(mrb_state* mrb, ondemand::value &object, const ConvertOptions &opts, unsigned depth) {
   ondemand::object obj;
   auto code = object.get_object().get(obj);
-  bool is_empty;
-  if (likely(code == SUCCESS)) code = obj.is_empty().get(is_empty);
+  size_t count = 0;
+  const bool presize = depth < JSON_ONDEMAND_PRESIZE_DEPTH;
+  if (likely(code == SUCCESS) && presize) code = obj.count_fields().get(count);
   if (likely(code == SUCCESS)) {
-    if (is_empty) return mrb_hash_new(mrb);
-    mrb_value hash = mrb_hash_new(mrb);
+    if (presize && count == 0) return mrb_hash_new(mrb);
+    mrb_value hash = presize ? mrb_hash_new_capa(mrb, static_cast<mrb_int>(count)) : mrb_hash_new(mrb);
     mrb_gc_protect(mrb, hash);
     int arena = mrb_gc_arena_save(mrb);
     for (auto field : obj) {
       std::string_view k;
       ondemand::value v;
-      code = field.escaped_key().get(k);
+      code = field.unescaped_key().get(k);
       if (likely(code == SUCCESS)) code = field.value().get(v);
       if (likely(code == SUCCESS)) {
-        mrb_value key = mrb_str_new(mrb, k.data(), k.size());
+        mrb_value key = convert_key(mrb, k, opts);
         mrb_gc_protect(mrb, key);
-        mrb_value val = convert_ondemand_value_to_mrb(mrb, v);
+        mrb_value val = convert_ondemand_value_to_mrb(mrb, v, opts, depth + 1);
         mrb_gc_protect(mrb, val);
         mrb_hash_set(mrb, hash, key, val);
         mrb_gc_arena_restore(mrb, arena);
@@ -446,14 +1529,47 @@ static mrb_value convert_ondemand_object(mrb_state* mrb, ondemand::value &object
   return mrb_undef_value();
 }
 
-static mrb_value convert_number_from_ondemand(mrb_state *mrb, ondemand::value& v) {
+// Longer digit runs raise BigIntError: decimal-to-binary conversion is
+// quadratic in the digit count, so unbounded runs are a cheap way to stall
+// the parser. 4300 digits is the limit CPython settled on for int().
+#define JSON_BIGINT_MAX_DIGITS 4300
+
+// raw is the number token as simdjson saw it: an optional '-' and digits,
+// possibly followed by whitespace.
+static mrb_value json_bigint_from_digits(mrb_state *mrb, std::string_view raw, const ConvertOptions &opts) {
+  size_t n = (!raw.empty() && raw[0] == '-') ? 1 : 0;
+  const size_t digits_start = n;
+  while (n < raw.size() && static_cast<unsigned char>(raw[n] - '0') < 10) n++;
+  if (unlikely(n - digits_start > JSON_BIGINT_MAX_DIGITS)) raise_simdjson_error(mrb, BIGINT_ERROR);
+  JSON_STAT_ADD(mrb, bigints, 1);
+  switch (opts.bigint) {
+    case BIGINT_AS_STRING: return mrb_str_new(mrb, raw.data(), n);
+    case BIGINT_AS_RAW: {
+      mrb_value digits = mrb_str_new(mrb, raw.data(), n);
+      return mrb_obj_new(mrb, opts.state->raw_cls, 1, &digits);
+    }
+    case BIGINT_AS_INTEGER: break;
+  }
+#ifdef MRB_USE_BIGINT
+  // Straight into the bigint's limbs, no temporary String or re-scan.
+  return mrb_bint_new_str(mrb, raw.data(), static_cast<mrb_int>(n), 10);
+#else
+  return mrb_str_to_integer(mrb, mrb_str_new(mrb, raw.data(), n), 10, TRUE);
+#endif
+}
+
+template <typename simdjson_value>
+static mrb_value convert_number_from_ondemand(mrb_state *mrb, simdjson_value& v, const ConvertOptions &opts) {
   using namespace ondemand;
   number_type type;
   auto code = v.get_number_type().get(type);
   if (likely(code == SUCCESS)) {
     if (type == number_type::big_integer) {
-      auto sv = v.raw_json_token();
-      return mrb_str_to_integer(mrb, mrb_str_new_static(mrb, sv.data(), sv.size()), 0, 0);
+      // value returns the token directly, document_reference wraps it in a result
+      std::string_view sv;
+      code = simdjson_result<std::string_view>(v.raw_json_token()).get(sv);
+      if (likely(code == SUCCESS)) return json_bigint_from_digits(mrb, sv, opts);
+      raise_simdjson_error(mrb, code);
     }
     number number;
     code = v.get_number().get(number);
@@ -461,7 +1577,7 @@ static mrb_value convert_number_from_ondemand(mrb_state *mrb, ondemand::value& v
       switch (type) {
         case number_type::floating_point_number: return mrb_convert_number(mrb, number.get_double());
         case number_type::signed_integer:        return mrb_convert_number(mrb, number.get_int64());
-        case number_type::unsigned_integer:      return mrb_convert_number(mrb, number.get_uint64());
+        case number_type::unsigned_integer:      return json_uint64_to_mrb(mrb, number.get_uint64(), opts);
         default: mrb_raise(mrb, E_JSON_NUMBER_ERROR, "unknown number type");
       }
     }
@@ -470,15 +1586,18 @@ static mrb_value convert_number_from_ondemand(mrb_state *mrb, ondemand::value& v
   return mrb_undef_value();
 }
 
-static mrb_value convert_string_from_ondemand(mrb_state* mrb, ondemand::value& v) {
+template <typename simdjson_value>
+static mrb_value convert_string_from_ondemand(mrb_state* mrb, simdjson_value& v) {
   std::string_view dec;
   auto code = v.get_string().get(dec);
+  JSON_STAT_ADD(mrb, strings, 1);
   if (likely(code == SUCCESS)) return mrb_str_new(mrb, dec.data(), dec.size());
   raise_simdjson_error(mrb, code);
   return mrb_undef_value();
 }
 
-static mrb_value convert_boolean_from_ondemand(mrb_state *mrb, ondemand::value &v) {
+template <typename simdjson_value>
+static mrb_value convert_boolean_from_ondemand(mrb_state *mrb, simdjson_value &v) {
   bool boolean;
   auto code = v.get_bool().get(boolean);
   if (likely(code == SUCCESS)) return mrb_bool_value(boolean);
@@ -486,13 +1605,30 @@ static mrb_value convert_boolean_from_ondemand(mrb_state *mrb, ondemand::value &
   return mrb_undef_value();
 }
 
-static mrb_value convert_ondemand_value_to_mrb(mrb_state* mrb, ondemand::value& v) {
+// raw_json_token() peeks without consuming and starts at the opening quote.
+// If no backslash comes before the next '"', that quote closes the string
+// and the bytes in between are the value verbatim; mruby then shares the
+// frozen source's buffer for anything too long to embed.
+static mrb_value convert_ondemand_string(mrb_state *mrb, ondemand::value &v, const ConvertOptions &opts) {
+  if (opts.shared_base) {
+    std::string_view raw = v.raw_json_token();
+    const char *p = raw.data() + 1;
+    const char *q = static_cast<const char *>(std::memchr(p, '"', raw.size() - 1));
+    if (likely(q && !std::memchr(p, '\\', q - p))) {
+      JSON_STAT_ADD(mrb, strings, 1);
+      return mrb_str_byte_subseq(mrb, opts.shared_source, p - opts.shared_base, q - p);
+    }
+  }
+  return convert_string_from_ondemand(mrb, v);
+}
+
+static mrb_value convert_ondemand_value_to_mrb(mrb_state* mrb, ondemand::value& v, const ConvertOptions &opts, unsigned depth) {
   using namespace ondemand;
   switch (v.type()) {
-    case json_type::object:  return convert_ondemand_object(mrb, v);
-    case json_type::array:   return convert_ondemand_array(mrb, v);
-    case json_type::string:  return convert_string_from_ondemand(mrb, v);
-    case json_type::number:  return convert_number_from_ondemand(mrb, v);
+    case json_type::object:  return convert_ondemand_object(mrb, v, opts, depth);
+    case json_type::array:   return convert_ondemand_array(mrb, v, opts, depth);
+    case json_type::string:  return convert_ondemand_string(mrb, v, opts);
+    case json_type::number:  return convert_number_from_ondemand(mrb, v, opts);
     case json_type::boolean: return convert_boolean_from_ondemand(mrb, v);
     case json_type::null:    return mrb_nil_value();
     default: mrb_raise(mrb, E_TYPE_ERROR, "unknown JSON type"); break;
@@ -500,11 +1636,164 @@ static mrb_value convert_ondemand_value_to_mrb(mrb_state* mrb, ondemand::value&
   return mrb_undef_value();
 }
 
+// Scalar documents cannot be turned into an ondemand::value, so documents
+// are dispatched here and only containers go through get_value().
+template <typename simdjson_document>
+static mrb_value convert_ondemand_document_to_mrb(mrb_state* mrb, simdjson_document& doc, const ConvertOptions &opts) {
+  using namespace ondemand;
+  json_type type;
+  auto code = doc.type().get(type);
+  if (likely(code == SUCCESS)) {
+    switch (type) {
+      case json_type::object:
+      case json_type::array: {
+        ondemand::value v;
+        code = doc.get_value().get(v);
+        if (likely(code == SUCCESS)) return convert_ondemand_value_to_mrb(mrb, v, opts);
+      } break;
+      case json_type::string:  return convert_string_from_ondemand(mrb, doc);
+      case json_type::number:  return convert_number_from_ondemand(mrb, doc, opts);
+      case json_type::boolean: return convert_boolean_from_ondemand(mrb, doc);
+      case json_type::null:    return mrb_nil_value();
+      default: mrb_raise(mrb, E_TYPE_ERROR, "unknown JSON type"); break;
+    }
+  }
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+// Whole-document OnDemand conversion for what the DOM tape cannot carry:
+// shared_strings needs to know where each string sits in the source, and
+// big integers need their digits. buf must be padded.
+static ondemand::parser *json_default_ondemand_parser(mrb_state *mrb) {
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  mrb_value parser_obj = mrb_iv_get(mrb, mrb_obj_value(json_mod), MRB_SYM(default_ondemand_parser));
+  if (mrb_nil_p(parser_obj)) {
+    parser_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser)), 0, NULL);
+    mrb_iv_set(mrb, mrb_obj_value(json_mod), MRB_SYM(default_ondemand_parser), parser_obj);
+  }
+  return mrb_cpp_get<ondemand::parser>(mrb, parser_obj);
+}
+
+static mrb_value json_ondemand_parse_convert(mrb_state *mrb, const char *buf, size_t len, const ConvertOptions &opts) {
+  ondemand::parser *parser = json_default_ondemand_parser(mrb);
+  ondemand::document doc;
+  auto code = parser->iterate(buf, len, len + SIMDJSON_PADDING).get(doc);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  JSON_STAT_ADD(mrb, documents, 1);
+  mrb_value out = convert_ondemand_document_to_mrb(mrb, doc, opts);
+  if (unlikely(!doc.at_end())) raise_simdjson_error(mrb, TRAILING_CONTENT);
+  return out;
+}
+
+// JSON.valid? / JSON.validate!: the full DOM stage 1 + 2 into the shared
+// parser, with nothing built on the Ruby side. Documents with integers beyond
+// 64 bits stop stage 2 early, so they are walked again with OnDemand, where
+// every scalar is decoded into the parser's own buffers.
+template <typename simdjson_value>
+static error_code validate_ondemand(simdjson_value &v) {
+  using namespace ondemand;
+  json_type type;
+  auto code = v.type().get(type);
+  if (unlikely(code != SUCCESS)) return code;
+  switch (type) {
+    case json_type::object: {
+      object obj;
+      code = v.get_object().get(obj);
+      if (unlikely(code != SUCCESS)) return code;
+      for (auto field : obj) {
+        std::string_view key;
+        value child;
+        code = field.unescaped_key().get(key);
+        if (likely(code == SUCCESS)) code = field.value().get(child);
+        if (likely(code == SUCCESS)) code = validate_ondemand(child);
+        if (unlikely(code != SUCCESS)) return code;
+      }
+      return SUCCESS;
+    }
+    case json_type::array: {
+      array arr;
+      code = v.get_array().get(arr);
+      if (unlikely(code != SUCCESS)) return code;
+      for (auto item : arr) {
+        value child;
+        code = item.get(child);
+        if (likely(code == SUCCESS)) code = validate_ondemand(child);
+        if (unlikely(code != SUCCESS)) return code;
+      }
+      return SUCCESS;
+    }
+    case json_type::string: return v.get_string().error();
+    case json_type::number: {
+      number_type nt;
+      code = v.get_number_type().get(nt);
+      if (likely(code == SUCCESS) && nt != number_type::big_integer) code = v.get_number().error();
+      return code;
+    }
+    case json_type::boolean: {
+      // OnDemand reports a bad atom as a type mismatch; report what the DOM would
+      code = v.get_bool().error();
+      if (code != INCORRECT_TYPE) return code;
+      std::string_view raw;
+      if (simdjson_result<std::string_view>(v.raw_json_token()).get(raw) == SUCCESS && !raw.empty() && raw[0] == 'f')
+        return F_ATOM_ERROR;
+      return T_ATOM_ERROR;
+    }
+    case json_type::null: {
+      bool is_null;
+      code = v.is_null().get(is_null);
+      return likely(code == SUCCESS) && !is_null ? N_ATOM_ERROR : code;
+    }
+    default: return UNEXPECTED_ERROR;
+  }
+}
+
+static error_code json_validate(mrb_state *mrb, mrb_value str) {
+  padded_string jsonbuffer;
+  auto view = simdjson_readonly_view_from_mrb_string(mrb, str, jsonbuffer);
+  dom::parser *dom = mrb_cpp_get<dom::parser>(mrb, json_default_dom_parser(mrb, json_state(mrb)->json_mod));
+  auto code = dom->parse(view.data(), view.length(), false).error();
+  if (unlikely(code != SUCCESS)) dom_parser_forget_tape(dom);
+  if (likely(code != BIGINT_ERROR)) return code;
+  ondemand::document doc;
+  code = json_default_ondemand_parser(mrb)->iterate(view).get(doc);
+  if (likely(code == SUCCESS)) code = validate_ondemand(doc);
+  if (likely(code == SUCCESS) && !doc.at_end()) code = TRAILING_CONTENT;
+  return code;
+}
+
+static mrb_value mrb_json_valid_p(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+  return mrb_bool_value(json_validate(mrb, str) == SUCCESS);
+}
+
+static mrb_value mrb_json_validate_bang(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+  auto code = json_validate(mrb, str);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  return mrb_true_value();
+}
+
+// Conversion options of a JSON::Document. The key cache lives for one method
+// call, so it dedupes keys across everything that call converts.
+struct DocumentConvert {
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  DocumentConvert(mrb_state *mrb, mrb_value doc) {
+    if (mrb_test(mrb_iv_get(mrb, doc, MRB_SYM(cache_keys)))) opts.key_cache = &key_cache.emplace(mrb);
+  }
+  DocumentConvert(const DocumentConvert &) = delete;
+  DocumentConvert &operator=(const DocumentConvert &) = delete;
+};
+
 static ondemand::document* mrb_json_doc_get(mrb_state* mrb, mrb_value self) {
   ondemand::document *doc = mrb_cpp_get<ondemand::document>(mrb, self);
   if (likely(doc->is_alive())) return doc;
   mrb_value view_obj   = mrb_iv_get(mrb, self, MRB_SYM(view));
   mrb_value parser_obj = mrb_iv_get(mrb, self, MRB_SYM(parser));
+  if (unlikely(mrb_nil_p(parser_obj))) mrb_raise(mrb, E_JSON_UNINITIALIZED_ERROR, "document is closed");
   auto *view   = mrb_cpp_get<padded_string_view>(mrb, view_obj);
   auto *parser = mrb_cpp_get<ondemand::parser>(mrb, parser_obj);
   auto code = parser->iterate(*view).get(*doc);
@@ -524,11 +1813,12 @@ static mrb_value mrb_json_doc_aref(mrb_state* mrb, mrb_value self) {
   mrb_value value = mrb_hash_fetch(mrb, cache, key, mrb_undef_value());
   if (!mrb_undef_p(value)) return value;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view k(RSTRING_PTR(key), RSTRING_LEN(key));
   ondemand::value val;
   auto code = (*doc)[k].get(val);
   if (likely(code == SUCCESS)) {
-    value = convert_ondemand_value_to_mrb(mrb, val);
+    value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
     mrb_gc_protect(mrb, value);
     mrb_hash_set(mrb, cache, key, value);
     return value;
@@ -545,11 +1835,12 @@ static mrb_value mrb_json_doc_fetch(mrb_state* mrb, mrb_value self) {
   mrb_value value = mrb_hash_fetch(mrb, cache, key_or_index, mrb_undef_value());
   if (!mrb_undef_p(value)) return value;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   if (mrb_integer_p(key_or_index)) {
     ondemand::value val;
     auto code = doc->at(static_cast<size_t>(mrb_integer(key_or_index))).get(val);
     if (likely(code == SUCCESS)) {
-      value = convert_ondemand_value_to_mrb(mrb, val);
+      value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
       mrb_gc_protect(mrb, value);
       mrb_hash_set(mrb, cache, key_or_index, value);
       return value;
@@ -567,7 +1858,7 @@ static mrb_value mrb_json_doc_fetch(mrb_state* mrb, mrb_value self) {
   ondemand::value val;
   auto code = (*doc)[k].get(val);
   if (likely(code == SUCCESS)) {
-    value = convert_ondemand_value_to_mrb(mrb, val);
+    value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
     mrb_gc_protect(mrb, value);
     mrb_hash_set(mrb, cache, key_or_index, value);
     return value;
@@ -588,11 +1879,12 @@ static mrb_value mrb_json_doc_find_field(mrb_state* mrb, mrb_value self) {
   mrb_value value = mrb_hash_fetch(mrb, cache, key, mrb_undef_value());
   if (!mrb_undef_p(value)) return value;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view k(RSTRING_PTR(key), RSTRING_LEN(key));
   ondemand::value val;
   const auto code = doc->find_field(k).get(val);
   if (likely(code == SUCCESS)) {
-    value = convert_ondemand_value_to_mrb(mrb, val);
+    value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
     mrb_gc_protect(mrb, value);
     mrb_hash_set(mrb, cache, key, value);
     return value;
@@ -609,11 +1901,12 @@ static mrb_value mrb_json_doc_find_field_unordered(mrb_state* mrb, mrb_value sel
   mrb_value value = mrb_hash_fetch(mrb, cache, key, mrb_undef_value());
   if (!mrb_undef_p(value)) return value;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view k(RSTRING_PTR(key), RSTRING_LEN(key));
   ondemand::value val;
   auto code = doc->find_field_unordered(k).get(val);
   if (likely(code == SUCCESS)) {
-    value = convert_ondemand_value_to_mrb(mrb, val);
+    value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
     mrb_gc_protect(mrb, value);
     mrb_hash_set(mrb, cache, key, value);
     return value;
@@ -630,11 +1923,12 @@ static mrb_value mrb_json_doc_at(mrb_state* mrb, mrb_value self) {
   mrb_value value = mrb_hash_fetch(mrb, cache, index, mrb_undef_value());
   if (!mrb_undef_p(value)) return value;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   ondemand::value val;
   mrb_value normalized_index = mrb_ensure_int_type(mrb, index);
   const auto code = doc->at(mrb_integer(normalized_index)).get(val);
   if (likely(code == SUCCESS)) {
-    value = convert_ondemand_value_to_mrb(mrb, val);
+    value = convert_ondemand_value_to_mrb(mrb, val, conv.opts);
     mrb_gc_protect(mrb, value);
     mrb_hash_set(mrb, cache, index, value);
     return value;
@@ -651,11 +1945,12 @@ static mrb_value mrb_json_doc_at_pointer(mrb_state* mrb, mrb_value self) {
   mrb_value val = mrb_hash_fetch(mrb, cache, ptr_val, mrb_undef_value());
   if (!mrb_undef_p(val)) return val;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view json_pointer(RSTRING_PTR(ptr_val), RSTRING_LEN(ptr_val));
   ondemand::value value;
   auto code = doc->at_pointer(json_pointer).get(value);
   if (likely(code == SUCCESS)) {
-    val = convert_ondemand_value_to_mrb(mrb, value);
+    val = convert_ondemand_value_to_mrb(mrb, value, conv.opts);
     mrb_gc_protect(mrb, val);
     mrb_hash_set(mrb, cache, ptr_val, val);
     return val;
@@ -665,6 +1960,79 @@ static mrb_value mrb_json_doc_at_pointer(mrb_state* mrb, mrb_value self) {
   return mrb_undef_value();
 }
 
+// Raw JSON text of a value, copied once into a frozen String. Scalar tokens
+// can carry the whitespace that follows them, which is trimmed here.
+static mrb_value json_raw_string(mrb_state *mrb, std::string_view raw) {
+  while (!raw.empty() && (raw.back() == ' ' || raw.back() == '\n' || raw.back() == '\r' || raw.back() == '\t'))
+    raw.remove_suffix(1);
+  return mrb_obj_freeze(mrb, mrb_str_new(mrb, raw.data(), raw.size()));
+}
+
+static mrb_value mrb_json_doc_raw(mrb_state* mrb, mrb_value self) {
+  mrb_value ptr_val;
+  mrb_get_args(mrb, "S", &ptr_val);
+  auto *doc = mrb_json_doc_get(mrb, self);
+  std::string_view json_pointer(RSTRING_PTR(ptr_val), RSTRING_LEN(ptr_val));
+  std::string_view raw;
+  error_code code;
+  if (json_pointer.empty()) {
+    doc->rewind();
+    code = doc->raw_json().get(raw);
+  } else {
+    ondemand::value value;
+    code = doc->at_pointer(json_pointer).get(value);
+    if (likely(code == SUCCESS)) code = value.raw_json().get(raw);
+  }
+  if (likely(code == SUCCESS)) return json_raw_string(mrb, raw);
+  if (is_lookup_miss(code)) return mrb_nil_value();
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+// count_elements / count_fields walk the structural index of one container
+// (nested values are skipped over, not decoded) and leave the document
+// rewound. An empty pointer means the root; a missing path returns nil.
+template <bool fields>
+static mrb_value json_doc_count(mrb_state *mrb, mrb_value self) {
+  const char *ptr = "";
+  mrb_int ptr_len = 0;
+  mrb_get_args(mrb, "|s", &ptr, &ptr_len);
+  auto *doc = mrb_json_doc_get(mrb, self);
+  doc->rewind();
+  size_t count = 0;
+  error_code code;
+  if (ptr_len == 0) {
+    code = fields ? doc->count_fields().get(count) : doc->count_elements().get(count);
+  } else {
+    ondemand::value value;
+    code = doc->at_pointer(std::string_view(ptr, ptr_len)).get(value);
+    if (likely(code == SUCCESS)) code = fields ? value.count_fields().get(count) : value.count_elements().get(count);
+  }
+  doc->rewind();
+  if (likely(code == SUCCESS)) return mrb_convert_number(mrb, count);
+  if (is_lookup_miss(code)) return mrb_nil_value();
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+static mrb_value mrb_json_doc_count_elements(mrb_state* mrb, mrb_value self) { return json_doc_count<false>(mrb, self); }
+static mrb_value mrb_json_doc_count_fields(mrb_state* mrb, mrb_value self)   { return json_doc_count<true>(mrb, self); }
+
+// Skips over the whole root value, checking that its brackets balance and
+// nothing follows it, without decoding anything. Scalars inside are not
+// validated; use JSON.validate! for that.
+static mrb_value mrb_json_doc_skip(mrb_state* mrb, mrb_value self) {
+  auto *doc = mrb_json_doc_get(mrb, self);
+  doc->rewind();
+  std::string_view raw;
+  auto code = doc->raw_json().get(raw);
+  if (likely(code == SUCCESS) && !doc->at_end()) code = TRAILING_CONTENT;
+  doc->rewind();
+  if (likely(code == SUCCESS)) return self;
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
 static mrb_value mrb_json_doc_at_path(mrb_state* mrb, mrb_value self) {
   mrb_value path_val;
   mrb_get_args(mrb, "S", &path_val);
@@ -672,11 +2040,12 @@ static mrb_value mrb_json_doc_at_path(mrb_state* mrb, mrb_value self) {
   mrb_value val = mrb_hash_fetch(mrb, cache, path_val, mrb_undef_value());
   if (!mrb_undef_p(val)) return val;
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view json_path(RSTRING_PTR(path_val), RSTRING_LEN(path_val));
   ondemand::value value;
   auto code = doc->at_path(json_path).get(value);
   if (likely(code == SUCCESS)) {
-    val = convert_ondemand_value_to_mrb(mrb, value);
+    val = convert_ondemand_value_to_mrb(mrb, value, conv.opts);
     mrb_gc_protect(mrb, val);
     mrb_hash_set(mrb, cache, path_val, val);
     return val;
@@ -690,6 +2059,7 @@ static mrb_value mrb_json_doc_at_path_with_wildcard(mrb_state* mrb, mrb_value se
   mrb_value path_val, block = mrb_undef_value();
   mrb_get_args(mrb, "S|&", &path_val, &block);
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   std::string_view json_path(RSTRING_PTR(path_val), RSTRING_LEN(path_val));
   auto result = doc->at_path_with_wildcard(json_path);
   auto code = result.error();
@@ -697,13 +2067,13 @@ static mrb_value mrb_json_doc_at_path_with_wildcard(mrb_state* mrb, mrb_value se
     auto values = result.value();
     if (mrb_proc_p(block)) {
       int arena = mrb_gc_arena_save(mrb);
-      for (auto v : values) { mrb_yield(mrb, block, convert_ondemand_value_to_mrb(mrb, v)); mrb_gc_arena_restore(mrb, arena); }
+      for (auto v : values) { mrb_yield(mrb, block, convert_ondemand_value_to_mrb(mrb, v, conv.opts)); mrb_gc_arena_restore(mrb, arena); }
       return self;
     } else {
       mrb_value ary = mrb_ary_new(mrb);
       mrb_gc_protect(mrb, ary);
       int arena = mrb_gc_arena_save(mrb);
-      for (auto v : values) { mrb_ary_push(mrb, ary, convert_ondemand_value_to_mrb(mrb, v)); mrb_gc_arena_restore(mrb, arena); }
+      for (auto v : values) { mrb_ary_push(mrb, ary, convert_ondemand_value_to_mrb(mrb, v, conv.opts)); mrb_gc_arena_restore(mrb, arena); }
       return ary;
     }
   }
@@ -712,22 +2082,322 @@ static mrb_value mrb_json_doc_at_path_with_wildcard(mrb_state* mrb, mrb_value se
   return mrb_undef_value();
 }
 
+// JSON::Query compiles JSON Pointers and JSONPaths ($.a[0], $['b'], [*], .*)
+// into one trie. Document#extract walks the document once, taking only the
+// branches some path needs, and fills one slot per path. Paths with a
+// wildcard collect every match, in document order, into an Array.
+struct QueryNode {
+  std::string key;
+  int64_t index = -1;
+  bool has_key = false;
+  bool wildcard = false;
+  std::vector<size_t> children;
+  std::vector<size_t> terminals;
+
+  bool same_step(const QueryNode &o) const {
+    return has_key == o.has_key && wildcard == o.wildcard && index == o.index && key == o.key;
+  }
+  bool matches_key(std::string_view k) const { return wildcard || (has_key && key == k); }
+  bool matches_index(int64_t i) const { return wildcard || index == i; }
+};
+
+struct CompiledQuery {
+  std::vector<QueryNode> nodes{1};
+  std::vector<bool> multi;
+};
+
+MRB_CPP_DEFINE_TYPE(CompiledQuery, compiled_query);
+
+static bool query_index_token(std::string_view tok, int64_t &index) {
+  if (tok.empty() || tok.size() > 18 || (tok.size() > 1 && tok[0] == '0')) return false;
+  int64_t n = 0;
+  for (char c : tok) {
+    if (c < '0' || c > '9') return false;
+    n = n * 10 + (c - '0');
+  }
+  index = n;
+  return true;
+}
+
+static bool query_parse_pointer(std::string_view p, std::vector<QueryNode> &steps) {
+  size_t pos = 0;
+  while (pos < p.size()) {
+    if (p[pos] != '/') return false;
+    size_t end = p.find('/', pos + 1);
+    if (end == std::string_view::npos) end = p.size();
+    QueryNode step;
+    step.has_key = true;
+    for (size_t i = pos + 1; i < end; i++) {
+      if (p[i] != '~') { step.key += p[i]; continue; }
+      if (i + 1 >= end || (p[i + 1] != '0' && p[i + 1] != '1')) return false;
+      step.key += p[++i] == '0' ? '~' : '/';
+    }
+    query_index_token(step.key, step.index);
+    steps.push_back(std::move(step));
+    pos = end;
+  }
+  return true;
+}
+
+static bool query_parse_path(std::string_view p, std::vector<QueryNode> &steps) {
+  size_t pos = 1;
+  while (pos < p.size()) {
+    QueryNode step;
+    if (p[pos] == '.') {
+      size_t end = ++pos;
+      if (end < p.size() && p[end] == '*') { step.wildcard = true; pos = end + 1; steps.push_back(step); continue; }
+      while (end < p.size() && p[end] != '.' && p[end] != '[') end++;
+      if (end == pos) return false;
+      step.has_key = true;
+      step.key.assign(p.substr(pos, end - pos));
+      pos = end;
+    } else if (p[pos] == '[') {
+      size_t close;
+      if (pos + 1 < p.size() && (p[pos + 1] == '\'' || p[pos + 1] == '"')) {
+        const char quote = p[pos + 1];
+        size_t i = pos + 2;
+        for (; i < p.size() && p[i] != quote; i++) {
+          if (p[i] == '\\' && i + 1 < p.size()) i++;
+          step.key += p[i];
+        }
+        if (i + 1 >= p.size() || p[i + 1] != ']') return false;
+        step.has_key = true;
+        close = i + 1;
+      } else {
+        close = p.find(']', pos);
+        if (close == std::string_view::npos) return false;
+        std::string_view inner = p.substr(pos + 1, close - pos - 1);
+        if (inner == "*") step.wildcard = true;
+        else if (!query_index_token(inner, step.index)) return false;
+      }
+      pos = close + 1;
+    } else {
+      return false;
+    }
+    steps.push_back(std::move(step));
+  }
+  return true;
+}
+
+static void query_add_path(mrb_state *mrb, CompiledQuery &q, mrb_value path) {
+  std::string_view p(RSTRING_PTR(path), RSTRING_LEN(path));
+  std::vector<QueryNode> steps;
+  bool ok = (!p.empty() && p[0] == '$') ? query_parse_path(p, steps) : query_parse_pointer(p, steps);
+  if (unlikely(!ok)) mrb_raisef(mrb, E_JSON_INVALID_JSON_POINTER_ERROR, "invalid query path: %v", path);
+  size_t node = 0;
+  bool multi = false;
+  for (QueryNode &step : steps) {
+    multi = multi || step.wildcard;
+    size_t next = 0;
+    for (size_t child : q.nodes[node].children)
+      if (q.nodes[child].same_step(step)) { next = child; break; }
+    if (next == 0) {
+      next = q.nodes.size();
+      q.nodes.push_back(std::move(step));
+      q.nodes[node].children.push_back(next);
+    }
+    node = next;
+  }
+  q.nodes[node].terminals.push_back(q.multi.size());
+  q.multi.push_back(multi);
+}
+
+static mrb_value mrb_json_query_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value paths;
+  mrb_get_args(mrb, "A", &paths);
+  paths = mrb_ary_new_from_values(mrb, RARRAY_LEN(paths), RARRAY_PTR(paths));
+  CompiledQuery *q = mrb_cpp_new<CompiledQuery>(mrb, self);
+  mrb_iv_set(mrb, self, MRB_SYM(paths), paths);
+  for (mrb_int i = 0; i < RARRAY_LEN(paths); i++) {
+    mrb_value path = mrb_obj_freeze(mrb, mrb_str_dup(mrb, mrb_ensure_string_type(mrb, RARRAY_PTR(paths)[i])));
+    mrb_ary_set(mrb, paths, i, path);
+    query_add_path(mrb, *q, path);
+  }
+  mrb_obj_freeze(mrb, paths);
+  return self;
+}
+
+static mrb_value mrb_json_query_paths(mrb_state *mrb, mrb_value self) {
+  return mrb_iv_get(mrb, self, MRB_SYM(paths));
+}
+
+class QueryWalk {
+public:
+  QueryWalk(mrb_state *mrb, const CompiledQuery &q, mrb_value out, const ConvertOptions &opts)
+  : mrb(mrb), q(q), out(out), opts(opts) {}
+
+  void visit(ondemand::value &v, const QueryNode &n) {
+    if (n.terminals.empty()) { descend(v, n); return; }
+    mrb_value val = convert_ondemand_value_to_mrb(mrb, v, opts);
+    resolve(val, n);
+  }
+
+  // A value some path ends at is converted anyway, deeper paths read from it.
+  void resolve(mrb_value val, const QueryNode &n) {
+    record(n, val);
+    for (size_t c : n.children) {
+      const QueryNode &child = q.nodes[c];
+      if (mrb_hash_p(val)) {
+        if (child.wildcard) {
+          mrb_value values = mrb_hash_values(mrb, val);
+          for (mrb_int i = 0; i < RARRAY_LEN(values); i++) resolve(RARRAY_PTR(values)[i], child);
+        } else if (child.has_key) {
+          mrb_value k = opts.symbolize_names ? mrb_symbol_value(mrb_intern(mrb, child.key.data(), child.key.size()))
+                                             : mrb_str_new(mrb, child.key.data(), child.key.size());
+          mrb_value found = mrb_hash_fetch(mrb, val, k, mrb_undef_value());
+          if (!mrb_undef_p(found)) resolve(found, child);
+        }
+      } else if (mrb_array_p(val)) {
+        for (mrb_int i = 0; i < RARRAY_LEN(val); i++)
+          if (child.matches_index(i)) resolve(RARRAY_PTR(val)[i], child);
+      }
+    }
+  }
+
+  void descend(ondemand::value &v, const QueryNode &n) {
+    ondemand::json_type type;
+    auto code = v.type().get(type);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+    if (type == ondemand::json_type::object) descend_object(v, n);
+    else if (type == ondemand::json_type::array) descend_array(v, n);
+  }
+
+private:
+  void record(const QueryNode &n, mrb_value val) {
+    for (size_t slot : n.terminals) {
+      if (q.multi[slot]) mrb_ary_push(mrb, RARRAY_PTR(out)[slot], val);
+      else if (mrb_nil_p(RARRAY_PTR(out)[slot])) mrb_ary_set(mrb, out, slot, val);
+    }
+  }
+
+  // A container is left early once every child step has been taken, which
+  // needs no wildcard among them and at most 64 of them to track.
+  template <typename Named>
+  uint64_t pending_children(const QueryNode &n, Named named, bool &early) const {
+    uint64_t pending = 0;
+    early = n.children.size() <= 64;
+    for (size_t i = 0; early && i < n.children.size(); i++) {
+      if (!named(q.nodes[n.children[i]])) early = false;
+      else pending |= uint64_t(1) << i;
+    }
+    return pending;
+  }
+
+  void descend_object(ondemand::value &v, const QueryNode &n) {
+    ondemand::object obj;
+    auto code = v.get_object().get(obj);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+    bool early;
+    uint64_t pending = pending_children(n, [](const QueryNode &c) { return c.has_key; }, early);
+    int arena = mrb_gc_arena_save(mrb);
+    for (auto field : obj) {
+      std::string_view k;
+      ondemand::value fv;
+      code = field.unescaped_key().get(k);
+      if (likely(code == SUCCESS)) code = field.value().get(fv);
+      if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+      take(fv, n, [&](const QueryNode &c) { return c.matches_key(k); }, pending);
+      mrb_gc_arena_restore(mrb, arena);
+      if (early && pending == 0) break;
+    }
+  }
+
+  void descend_array(ondemand::value &v, const QueryNode &n) {
+    ondemand::array arr;
+    auto code = v.get_array().get(arr);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+    bool early;
+    uint64_t pending = pending_children(n, [](const QueryNode &c) { return c.index >= 0; }, early);
+    int64_t index = 0;
+    int arena = mrb_gc_arena_save(mrb);
+    for (auto item : arr) {
+      ondemand::value iv;
+      code = item.get(iv);
+      if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+      take(iv, n, [&](const QueryNode &c) { return c.matches_index(index); }, pending);
+      mrb_gc_arena_restore(mrb, arena);
+      if (early && pending == 0) break;
+      index++;
+    }
+  }
+
+  // One matching child walks the value in place; a value two steps want is
+  // converted once and resolved on the Ruby side.
+  template <typename Match>
+  void take(ondemand::value &v, const QueryNode &n, Match match, uint64_t &pending) {
+    size_t matched = 0, first = 0;
+    for (size_t i = 0; i < n.children.size(); i++) {
+      if (!match(q.nodes[n.children[i]])) continue;
+      if (matched++ == 0) first = i;
+    }
+    if (matched == 0) return;
+    if (matched == 1) {
+      if (first < 64) pending &= ~(uint64_t(1) << first);
+      visit(v, q.nodes[n.children[first]]);
+      return;
+    }
+    mrb_value val = convert_ondemand_value_to_mrb(mrb, v, opts);
+    for (size_t i = 0; i < n.children.size(); i++) {
+      if (!match(q.nodes[n.children[i]])) continue;
+      if (i < 64) pending &= ~(uint64_t(1) << i);
+      resolve(val, q.nodes[n.children[i]]);
+    }
+  }
+
+  mrb_state *mrb;
+  const CompiledQuery &q;
+  mrb_value out;
+  const ConvertOptions &opts;
+};
+
+static mrb_value mrb_json_doc_extract(mrb_state *mrb, mrb_value self) {
+  mrb_value query;
+  mrb_get_args(mrb, "o", &query);
+  struct RClass *query_cls = mrb_class_get_under_id(mrb, json_state(mrb)->json_mod, MRB_SYM(Query));
+  if (!mrb_obj_is_kind_of(mrb, query, query_cls)) query = mrb_obj_new(mrb, query_cls, 1, &query);
+  mrb_gc_protect(mrb, query);
+  const CompiledQuery *q = mrb_cpp_get<CompiledQuery>(mrb, query);
+  auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
+  mrb_value out = mrb_ary_new_capa(mrb, q->multi.size());
+  mrb_gc_protect(mrb, out);
+  for (bool multi : q->multi) mrb_ary_push(mrb, out, multi ? mrb_ary_new(mrb) : mrb_nil_value());
+  QueryWalk walk(mrb, *q, out, conv.opts);
+  const QueryNode &root = q->nodes[0];
+  doc->rewind();
+  if (!root.terminals.empty()) {
+    walk.resolve(convert_ondemand_document_to_mrb(mrb, *doc, conv.opts), root);
+  } else if (!root.children.empty()) {
+    ondemand::json_type type;
+    auto code = doc->type().get(type);
+    if (likely(code == SUCCESS) && (type == ondemand::json_type::object || type == ondemand::json_type::array)) {
+      ondemand::value v;
+      code = doc->get_value().get(v);
+      if (likely(code == SUCCESS)) walk.descend(v, root);
+    }
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  }
+  doc->rewind();
+  return out;
+}
+
 static mrb_value mrb_json_doc_array_each(mrb_state* mrb, mrb_value self) {
   mrb_value block = mrb_undef_value();
   mrb_get_args(mrb, "|&", &block);
   auto *doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   ondemand::array array;
   auto code = doc->get_array().get(array);
   if (likely(code == SUCCESS)) {
     if (mrb_proc_p(block)) {
       int arena = mrb_gc_arena_save(mrb);
-      for (ondemand::value v : array) { mrb_yield(mrb, block, convert_ondemand_value_to_mrb(mrb, v)); mrb_gc_arena_restore(mrb, arena); }
+      for (ondemand::value v : array) { mrb_yield(mrb, block, convert_ondemand_value_to_mrb(mrb, v, conv.opts)); mrb_gc_arena_restore(mrb, arena); }
       return self;
     } else {
       mrb_value ary = mrb_ary_new(mrb);
       mrb_gc_protect(mrb, ary);
       int arena = mrb_gc_arena_save(mrb);
-      for (ondemand::value v : array) { mrb_ary_push(mrb, ary, convert_ondemand_value_to_mrb(mrb, v)); mrb_gc_arena_restore(mrb, arena); }
+      for (ondemand::value v : array) { mrb_ary_push(mrb, ary, convert_ondemand_value_to_mrb(mrb, v, conv.opts)); mrb_gc_arena_restore(mrb, arena); }
       return ary;
     }
   }
@@ -739,6 +2409,7 @@ static mrb_value mrb_json_doc_object_each(mrb_state* mrb, mrb_value self) {
   mrb_value block = mrb_undef_value();
   mrb_get_args(mrb, "|&", &block);
   auto* const doc = mrb_json_doc_get(mrb, self);
+  DocumentConvert conv(mrb, self);
   ondemand::object object;
   auto code = doc->get_object().get(object);
   if (likely(code == SUCCESS)) {
@@ -751,7 +2422,7 @@ static mrb_value mrb_json_doc_object_each(mrb_state* mrb, mrb_value self) {
         if (likely(code == SUCCESS)) {
           mrb_value key = mrb_str_new(mrb, k.data(), k.size());
           mrb_gc_protect(mrb, key);
-          mrb_value val = convert_ondemand_value_to_mrb(mrb, v);
+          mrb_value val = convert_ondemand_value_to_mrb(mrb, v, conv.opts);
           mrb_gc_protect(mrb, val);
           mrb_value argv[] = {key, val};
           mrb_yield_argv(mrb, block, 2, argv);
@@ -768,7 +2439,7 @@ static mrb_value mrb_json_doc_object_each(mrb_state* mrb, mrb_value self) {
         code = field.unescaped_key().get(k);
         if (likely(code == SUCCESS)) code = field.value().get(v);
         if (likely(code == SUCCESS)) {
-          mrb_hash_set(mrb, hash, mrb_str_new(mrb, k.data(), k.size()), convert_ondemand_value_to_mrb(mrb, v));
+          mrb_hash_set(mrb, hash, convert_key(mrb, k, conv.opts), convert_ondemand_value_to_mrb(mrb, v, conv.opts));
           mrb_gc_arena_restore(mrb, arena);
         }
       }
@@ -780,13 +2451,14 @@ static mrb_value mrb_json_doc_object_each(mrb_state* mrb, mrb_value self) {
 }
 
 static mrb_value mrb_json_doc_rewind(mrb_state* mrb, mrb_value self) {
-  mrb_cpp_get<ondemand::document>(mrb, self)->rewind();
+  mrb_json_doc_get(mrb, self)->rewind();
   return self;
 }
 
 static mrb_value mrb_json_doc_reiterate(mrb_state *mrb, mrb_value self) {
   mrb_value view_obj   = mrb_iv_get(mrb, self, MRB_SYM(view));
   mrb_value parser_obj = mrb_iv_get(mrb, self, MRB_SYM(parser));
+  if (unlikely(mrb_nil_p(parser_obj))) mrb_raise(mrb, E_JSON_UNINITIALIZED_ERROR, "document is closed");
   auto *view   = mrb_cpp_get<padded_string_view>(mrb, view_obj);
   auto *parser = mrb_cpp_get<ondemand::parser>(mrb, parser_obj);
   auto result = parser->iterate(*view);
@@ -799,101 +2471,1009 @@ static mrb_value mrb_json_doc_reiterate(mrb_state *mrb, mrb_value self) {
 }
 
 // ============================================================================
-// MrubyDeserialize — uses mrb_net_check_type with Ruby classes
-//
-// Schema stores { :@ivar => SomeClass } where SomeClass is a Ruby Class or
-// Module. We convert the JSON field to a Ruby value first, then call
-// mrb_net_check_type (which does is_a? via mrb_obj_is_kind_of) to validate.
+// JSON::ParserPool — a fixed set of warm OnDemand parsers for code that keeps
+// several documents alive at once (fibers). Each live Document holds a
+// JSON::ParserLease; closing the document, or the GC freeing it, frees the
+// slot. The lease flag lives in shared C++ state, so the lease destructor can
+// run during a GC sweep without touching any Ruby object.
 // ============================================================================
 
-class MrubyDeserialize {
-public:
-  mrb_state *mrb;
-  mrb_value into;
+struct ParserPoolSlots {
+  std::vector<uint8_t> leased;
+};
 
-  explicit MrubyDeserialize(mrb_state *mrb, mrb_value into) : mrb(mrb), into(into) {}
-
-  // Returns true and sets the ivar if field found and type matches.
-  // Returns false with err == NO_SUCH_FIELD if field not in document (caller skips).
-  // Returns false with err == INCORRECT_TYPE on type mismatch (caller stops).
-  bool validate_and_set_field(mrb_value key, mrb_value schema_class,
-                              ondemand::object *obj, error_code &err)
-  {
-    if (unlikely(!mrb_symbol_p(key))) { err = INCORRECT_TYPE; return false; }
-
-    // Extract ivar name as string_view, strip leading '@'
-    mrb_int len;
-    const char *str = mrb_sym_name_len(mrb, mrb_symbol(key), &len);
-    if (unlikely(!str)) { err = UNEXPECTED_ERROR; return false; }
-    std::string_view sv(str, len);
-    while (!sv.empty() && sv[0] == '@') sv.remove_prefix(1);
-
-    // Look up field in JSON object
-    ondemand::value json_field;
-    err = (*obj)[sv].get(json_field);
-    if (err == NO_SUCH_FIELD) return false; // caller will skip silently
-    if (unlikely(err != SUCCESS)) return false;
-
-    // Convert JSON -> Ruby value
-    mrb_value ruby_value = convert_ondemand_value_to_mrb(mrb, json_field);
-    mrb_gc_protect(mrb, ruby_value);
-
-    // Type check: schema_class must be a Ruby Class/Module, use is_a?
-    if (likely(mrb_net_check_type(mrb, schema_class, ruby_value))) {
-      mrb_iv_set(mrb, into, mrb_symbol(key), ruby_value);
-      return true;
-    }
+struct ParserPool {
+  std::shared_ptr<ParserPoolSlots> slots = std::make_shared<ParserPoolSlots>();
+};
 
-    err = INCORRECT_TYPE;
-    return false;
+struct ParserLease {
+  std::shared_ptr<ParserPoolSlots> slots;
+  size_t slot;
+  ParserLease(std::shared_ptr<ParserPoolSlots> s, size_t i) : slots(std::move(s)), slot(i) { slots->leased[slot] = 1; }
+  ~ParserLease() { release(); }
+  void release() {
+    if (slots) { slots->leased[slot] = 0; slots.reset(); }
   }
 };
 
-namespace simdjson {
+MRB_CPP_DEFINE_TYPE(ParserPool, parser_pool);
+MRB_CPP_DEFINE_TYPE(ParserLease, parser_lease);
 
-template <typename simdjson_value>
-auto tag_invoke(deserialize_tag, simdjson_value &val, MrubyDeserialize& mruby) {
-  ondemand::object obj;
-  auto err = val.get_object().get(obj);
-  if (unlikely(err != SUCCESS)) return err;
+static mrb_value mrb_json_parser_pool_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value kw_values[2] = {mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(size), MRB_SYM(capacity)};
+  mrb_kwargs kwargs = {2, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, ":", &kwargs);
+  mrb_int size = mrb_undef_p(kw_values[0]) ? 4 : mrb_as_int(mrb, kw_values[0]);
+  mrb_int capacity = mrb_undef_p(kw_values[1]) || mrb_nil_p(kw_values[1]) ? 0 : mrb_as_int(mrb, kw_values[1]);
+  if (unlikely(size < 1)) mrb_raise(mrb, E_ARGUMENT_ERROR, "size must be positive");
+  if (unlikely(capacity < 0)) mrb_raise(mrb, E_ARGUMENT_ERROR, "capacity must not be negative");
+  auto *pool = mrb_cpp_new<ParserPool>(mrb, self);
+  pool->slots->leased.assign(static_cast<size_t>(size), 0);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  struct RClass *od_cls = mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser));
+  mrb_value parsers = mrb_ary_new_capa(mrb, size);
+  mrb_iv_set(mrb, self, MRB_SYM(parsers), parsers);
+  for (mrb_int i = 0; i < size; ++i) {
+    mrb_value parser_obj = mrb_obj_new(mrb, od_cls, 0, NULL);
+    mrb_ary_push(mrb, parsers, parser_obj);
+    if (capacity > 0) {
+      auto code = mrb_cpp_get<ondemand::parser>(mrb, parser_obj)->allocate(capacity, DEFAULT_MAX_DEPTH);
+      if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+    }
+  }
+  mrb_value dom_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(DomParser)), 0, NULL);
+  mrb_iv_set(mrb, self, MRB_SYM(dom_parser), dom_obj);
+  if (capacity > 0) {
+    dom::parser *dom = mrb_cpp_get<dom::parser>(mrb, dom_obj);
+    auto code = dom->allocate(capacity, dom->max_depth());
+    if (likely(code == SUCCESS)) code = dom->doc.allocate(capacity);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  }
+  return self;
+}
 
-  mrb_state *mrb = mruby.mrb;
-  struct RClass *klass = mrb_class(mrb, mruby.into);
-  mrb_value schema = mrb_net_schema(mrb, klass);
-  if (unlikely(!mrb_hash_p(schema))) return INCORRECT_TYPE;
+// A free slot, after one full GC to collect documents that were dropped
+// without close. Exhaustion raises instead of growing the pool.
+static size_t parser_pool_free_slot(mrb_state *mrb, ParserPool *pool) {
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const auto &leased = pool->slots->leased;
+    for (size_t i = 0; i < leased.size(); ++i)
+      if (!leased[i]) return i;
+    if (attempt == 0) mrb_full_gc(mrb);
+  }
+  mrb_raise(mrb, E_JSON_PARSER_IN_USE_ERROR, "all parsers in the pool are checked out");
+  return 0;
+}
 
-  struct Ctx {
-    MrubyDeserialize *mruby;
-    ondemand::object *obj;
-    error_code err = SUCCESS;
-  } ctx{&mruby, &obj};
-
-  mrb_hash_foreach(
-    mrb,
-    mrb_hash_ptr(schema),
-    [](mrb_state *, mrb_value key, mrb_value schema_class, void *data) -> int {
-      auto *ctx = static_cast<Ctx*>(data);
-      if (likely(ctx->mruby->validate_and_set_field(key, schema_class, ctx->obj, ctx->err)))
-        return 0; // field set OK, continue
-      if (ctx->err == NO_SUCH_FIELD) {
-        ctx->err = SUCCESS; // field absent — skip silently (whitelist model)
-        return 0;
-      }
-      return 1; // real error (INCORRECT_TYPE etc.) — stop iteration
-    },
-    &ctx
-  );
+static mrb_value parser_pool_new_lease(mrb_state *mrb, ParserPool *pool, size_t slot) {
+  mrb_value lease = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_state(mrb)->json_mod, MRB_SYM(ParserLease)), 0, NULL);
+  mrb_cpp_new<ParserLease>(mrb, lease, pool->slots, slot);
+  return lease;
+}
 
-  return ctx.err;
+static mrb_value mrb_json_parser_pool_parse_lazy(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_value kw_values[1] = {mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {1, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S:", &str, &kwargs);
+  auto *pool = mrb_cpp_get<ParserPool>(mrb, self);
+  const size_t slot = parser_pool_free_slot(mrb, pool);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  mrb_value args[2] = {make_padded_string_view_from_ruby_str(mrb, str),
+                       mrb_ary_ref(mrb, mrb_iv_get(mrb, self, MRB_SYM(parsers)), static_cast<mrb_int>(slot))};
+  // The slot is only marked once the document exists, so a parse error
+  // leaves nothing checked out.
+  mrb_value doc = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document)), 2, args);
+  mrb_iv_set(mrb, doc, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(kw_values[0])));
+  mrb_iv_set(mrb, doc, MRB_SYM(lease), parser_pool_new_lease(mrb, pool, slot));
+  return doc;
 }
 
-} // namespace simdjson
+// Manual checkout for callers that drive the OnDemand parser themselves;
+// these leases end only with #checkin.
+static mrb_value mrb_json_parser_pool_checkout(mrb_state *mrb, mrb_value self) {
+  auto *pool = mrb_cpp_get<ParserPool>(mrb, self);
+  const size_t slot = parser_pool_free_slot(mrb, pool);
+  mrb_value parser_obj = mrb_ary_ref(mrb, mrb_iv_get(mrb, self, MRB_SYM(parsers)), static_cast<mrb_int>(slot));
+  mrb_iv_set(mrb, parser_obj, MRB_SYM(lease), parser_pool_new_lease(mrb, pool, slot));
+  return parser_obj;
+}
 
-static mrb_value mrb_document_deserialize(mrb_state *mrb, mrb_value self) {
+static void json_release_lease(mrb_state *mrb, mrb_value obj) {
+  mrb_value lease = mrb_iv_get(mrb, obj, MRB_SYM(lease));
+  if (mrb_nil_p(lease)) return;
+  mrb_cpp_get<ParserLease>(mrb, lease)->release();
+  mrb_iv_set(mrb, obj, MRB_SYM(lease), mrb_nil_value());
+}
+
+static mrb_value mrb_json_doc_close(mrb_state *mrb, mrb_value self);
+
+static mrb_value mrb_json_parser_pool_checkin(mrb_state *mrb, mrb_value self) {
+  mrb_value obj;
+  mrb_get_args(mrb, "o", &obj);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  if (mrb_obj_is_kind_of(mrb, obj, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(Document))))
+    mrb_json_doc_close(mrb, obj);
+  else if (mrb_obj_is_kind_of(mrb, obj, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandParser))))
+    json_release_lease(mrb, obj);
+  else
+    mrb_raise(mrb, E_TYPE_ERROR, "expected JSON::Document or JSON::OndemandParser");
+  return self;
+}
+
+static mrb_value mrb_json_parser_pool_available(mrb_state *mrb, mrb_value self) {
+  const auto &leased = mrb_cpp_get<ParserPool>(mrb, self)->slots->leased;
+  return mrb_convert_number(mrb, static_cast<mrb_int>(std::count(leased.begin(), leased.end(), 0)));
+}
+
+static mrb_value mrb_json_parser_pool_size(mrb_state *mrb, mrb_value self) {
+  return mrb_convert_number(mrb, static_cast<mrb_int>(mrb_cpp_get<ParserPool>(mrb, self)->slots->leased.size()));
+}
+
+static mrb_value mrb_json_parser_pool_dom_parser(mrb_state *mrb, mrb_value self) {
+  return mrb_iv_get(mrb, self, MRB_SYM(dom_parser));
+}
+
+// Frees the pool slot (if any) and detaches the document from its parser,
+// so later access raises instead of reading another document's index.
+static mrb_value mrb_json_doc_close(mrb_state *mrb, mrb_value self) {
+  json_release_lease(mrb, self);
+  *mrb_cpp_get<ondemand::document>(mrb, self) = ondemand::document();
+  mrb_iv_set(mrb, self, MRB_SYM(parser), mrb_nil_value());
+  mrb_iv_set(mrb, self, MRB_SYM(view), mrb_nil_value());
+  return mrb_nil_value();
+}
+
+static mrb_value mrb_json_doc_closed_p(mrb_state *mrb, mrb_value self) {
+  return mrb_bool_value(mrb_nil_p(mrb_iv_get(mrb, self, MRB_SYM(parser))));
+}
+
+// ============================================================================
+// JSON::Converter — DOM conversion in time-boxed steps. The document is
+// parsed up front (stage 1+2 run at GB/s); building the Ruby objects is the
+// slow part, so that is what #step spreads across calls. An explicit stack
+// of tape iterators replaces the recursion of convert_element, which also
+// lifts the native stack limit: max_depth: only bounds the tape.
+// Integers beyond 64 bits do not fit the tape; such documents are converted
+// in full by new, through the same OnDemand fallback as JSON.parse, and step
+// has nothing left to do.
+// Each container is stored into its parent as soon as it is created, so
+// everything built so far hangs off the result ivar and stays rooted.
+// ============================================================================
+
+struct JsonConverter {
+  struct Frame {
+    mrb_value container;
+    mrb_int capa;
+    bool is_object;
+    dom::array::iterator ai, ae;
+    dom::object::iterator oi, oe;
+  };
+  std::unique_ptr<dom::parser> parser;
+  std::vector<Frame> frames;
+  std::optional<KeyCache> key_cache;
+  ConvertOptions opts;
+};
+
+MRB_CPP_DEFINE_TYPE(JsonConverter, json_converter);
+
+// Scalars go through convert_element; containers are created empty and,
+// when not empty, pushed as a frame to be filled by later steps.
+static mrb_value json_converter_value(mrb_state *mrb, JsonConverter *conv, const dom::element &el) {
+  JsonConverter::Frame frame{};
+  switch (el.type()) {
+  case dom::element_type::ARRAY: {
+    dom::array arr = el.get_array().value_unsafe();
+    frame.capa = static_cast<mrb_int>(arr.size());
+    frame.container = mrb_ary_new_capa(mrb, frame.capa);
+    frame.ai = arr.begin(); frame.ae = arr.end();
+    if (frame.ai == frame.ae) return frame.container;
+  } break;
+  case dom::element_type::OBJECT: {
+    dom::object obj = el.get_object().value_unsafe();
+    frame.is_object = true;
+    frame.container = mrb_hash_new_capa(mrb, obj.size());
+    frame.oi = obj.begin(); frame.oe = obj.end();
+    if (frame.oi == frame.oe) return frame.container;
+  } break;
+  default:
+    return convert_element(mrb, el, conv->opts);
+  }
+  conv->frames.push_back(frame);
+  return frame.container;
+}
+
+static mrb_value mrb_json_converter_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_value kw_values[4] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(symbolize_names), MRB_SYM(cache_keys), MRB_SYM(max_depth), MRB_SYM(bigint)};
+  mrb_kwargs kwargs = {4, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S:", &str, &kwargs);
+  mrb_int max_depth = mrb_undef_p(kw_values[2]) ? DEFAULT_MAX_DEPTH : mrb_as_int(mrb, kw_values[2]);
+  if (unlikely(max_depth < 1)) mrb_raise(mrb, E_ARGUMENT_ERROR, "max_depth must be positive");
+  const BigintMode bigint = bigint_mode_from_kwarg(mrb, kw_values[3]);
+  auto *conv = mrb_cpp_new<JsonConverter>(mrb, self);
+  conv->opts.state = json_state(mrb);
+  conv->opts.symbolize_names = kwarg_test(kw_values[0]);
+  conv->opts.bigint = bigint;
+  if (kwarg_test(kw_values[1])) {
+    conv->opts.key_cache = &conv->key_cache.emplace(mrb);
+    mrb_iv_set(mrb, self, MRB_SYM(key_cache), conv->key_cache->roots());
+  }
+  conv->parser = std::make_unique<dom::parser>();
+  auto code = conv->parser->allocate(RSTRING_LEN(str), static_cast<size_t>(max_depth));
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  padded_string jsonbuffer;
+  auto view = simdjson_safe_view_from_mrb_string(mrb, str, jsonbuffer);
+  dom::element root;
+  code = conv->parser->parse(view.data(), view.length(), false).get(root);
+  if (unlikely(code == BIGINT_ERROR)) {
+    conv->parser.reset();
+    mrb_iv_set(mrb, self, MRB_SYM(result), json_ondemand_parse_convert(mrb, view.data(), view.length(), conv->opts));
+    return self;
+  }
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  JSON_STAT_ADD(mrb, documents, 1);
+  mrb_iv_set(mrb, self, MRB_SYM(result), json_converter_value(mrb, conv, root));
+  if (conv->frames.empty()) conv->parser.reset();
+  return self;
+}
+
+// Converts values until the document is done or budget_us microseconds
+// have passed; the clock is read every 256 values. Without a budget it
+// runs to the end. Returns true once the result is complete.
+static mrb_value mrb_json_converter_step(mrb_state *mrb, mrb_value self) {
+  mrb_value budget = mrb_nil_value();
+  mrb_get_args(mrb, "|o", &budget);
+  auto *conv = mrb_cpp_get<JsonConverter>(mrb, self);
+  const bool timed = !mrb_nil_p(budget);
+  const auto deadline = std::chrono::steady_clock::now() +
+    std::chrono::microseconds(timed ? mrb_as_int(mrb, budget) : 0);
+  auto &frames = conv->frames;
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_int n = 0;
+  while (!frames.empty()) {
+    JsonConverter::Frame &top = frames.back();
+    const mrb_value container = top.container;
+    if (top.is_object) {
+      if (top.oi == top.oe) { frames.pop_back(); continue; }
+      const dom::key_value_pair kv = *top.oi;
+      ++top.oi;
+      mrb_value key = convert_key(mrb, kv.key, conv->opts);
+      mrb_hash_set(mrb, container, key, json_converter_value(mrb, conv, kv.value));
+    } else {
+      if (top.ai == top.ae) { frames.pop_back(); continue; }
+      const dom::element el = *top.ai;
+      const mrb_int capa = top.capa;
+      ++top.ai;
+      json_ary_append(mrb, container, capa, json_converter_value(mrb, conv, el));
+    }
+    mrb_gc_arena_restore(mrb, ai);
+    if (timed && (++n & 255) == 0 && std::chrono::steady_clock::now() >= deadline) break;
+  }
+  if (frames.empty()) conv->parser.reset();
+  return mrb_bool_value(frames.empty());
+}
+
+static mrb_value mrb_json_converter_done_p(mrb_state *mrb, mrb_value self) {
+  return mrb_bool_value(mrb_cpp_get<JsonConverter>(mrb, self)->frames.empty());
+}
+
+// The partially built value is not handed out: appends bypass the frozen
+// and shared checks, so only the finished result is safe to touch.
+static mrb_value mrb_json_converter_result(mrb_state *mrb, mrb_value self) {
+  if (unlikely(!mrb_cpp_get<JsonConverter>(mrb, self)->frames.empty()))
+    mrb_raise(mrb, E_RUNTIME_ERROR, "conversion not finished, call step until it returns true");
+  return mrb_iv_get(mrb, self, MRB_SYM(result));
+}
+
+// ============================================================================
+// Document streams — NDJSON / concatenated documents via parse_many and
+// iterate_many. The stream lives inside a Ruby object so a raise or break
+// out of the block still lets the GC stop the stage 1 worker thread.
+// ============================================================================
+
+MRB_CPP_DEFINE_TYPE(dom::document_stream, dom_document_stream);
+MRB_CPP_DEFINE_TYPE(ondemand::document_stream, ondemand_document_stream);
+
+static mrb_value make_padded_string_view_from_mrb_value(mrb_state *mrb, mrb_value source) {
+  if (mrb_string_p(source)) return make_padded_string_view_from_ruby_str(mrb, source);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  struct RClass *psv_class = mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedStringView));
+  if (mrb_obj_is_kind_of(mrb, source, psv_class)) return source;
+  if (mrb_obj_is_kind_of(mrb, source, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(PaddedString))) ||
+      mrb_obj_is_kind_of(mrb, source, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(MappedString))))
+    return mrb_obj_new(mrb, psv_class, 1, &source);
+  mrb_raise(mrb, E_TYPE_ERROR, "expected String, JSON::PaddedString, JSON::MappedString or JSON::PaddedStringView");
+  return mrb_undef_value();
+}
+
+static size_t batch_size_from_kwarg(mrb_state *mrb, mrb_value batch_size) {
+  if (mrb_undef_p(batch_size)) return dom::DEFAULT_BATCH_SIZE;
+  mrb_int n = mrb_integer(mrb_ensure_int_type(mrb, batch_size));
+  if (unlikely(n <= 0)) mrb_raise(mrb, E_ARGUMENT_ERROR, "batch_size must be positive");
+  return static_cast<size_t>(n);
+}
+
+static mrb_value dom_parser_parse_many(mrb_state *mrb, mrb_value parser_obj, mrb_value source,
+                                       size_t batch_size, mrb_value symbolize_names, mrb_value cache_keys) {
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  mrb_value view_obj = make_padded_string_view_from_mrb_value(mrb, source);
+  mrb_gc_protect(mrb, view_obj);
+  mrb_value stream_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(DocumentStream)), 0, NULL);
+  mrb_gc_protect(mrb, stream_obj);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(view), view_obj);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(parser), parser_obj);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(symbolize_names), mrb_bool_value(kwarg_test(symbolize_names)));
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(cache_keys)));
+  auto *view   = mrb_cpp_get<padded_string_view>(mrb, view_obj);
+  auto *parser = mrb_cpp_get<dom::parser>(mrb, parser_obj);
+  auto *stream = mrb_cpp_new<dom::document_stream>(mrb, stream_obj);
+  auto code = parser->parse_many(reinterpret_cast<const uint8_t *>(view->data()), view->length(), batch_size).get(*stream);
+  if (likely(code == SUCCESS)) return stream_obj;
+  dom_parser_forget_tape(parser);
+  raise_simdjson_error(mrb, code);
+  return mrb_undef_value();
+}
+
+static mrb_value dom_document_stream_each(mrb_state *mrb, mrb_value self, mrb_value block) {
+  auto *stream = mrb_cpp_get<dom::document_stream>(mrb, self);
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  convert_options_from_kwargs(mrb, mrb_iv_get(mrb, self, MRB_SYM(symbolize_names)),
+                              mrb_iv_get(mrb, self, MRB_SYM(cache_keys)), opts, key_cache);
+  mrb_value ary = mrb_undef_value();
+  if (!mrb_proc_p(block)) { ary = mrb_ary_new(mrb); mrb_gc_protect(mrb, ary); }
+  int arena = mrb_gc_arena_save(mrb);
+  for (auto result : *stream) {
+    dom::element element;
+    auto code = result.get(element);
+    if (unlikely(code != SUCCESS)) {
+      dom_parser_forget_tape(mrb_cpp_get<dom::parser>(mrb, mrb_iv_get(mrb, self, MRB_SYM(parser))));
+      raise_simdjson_error(mrb, code);
+    }
+    JSON_STAT_ADD(mrb, documents, 1);
+    mrb_value val = convert_element(mrb, element, opts);
+    if (mrb_undef_p(ary)) mrb_yield(mrb, block, val); else mrb_ary_push(mrb, ary, val);
+    mrb_gc_arena_restore(mrb, arena);
+  }
+  return mrb_undef_p(ary) ? self : ary;
+}
+
+static mrb_value mrb_dom_parser_parse_many(mrb_state *mrb, mrb_value self) {
+  mrb_value source;
+  mrb_value kw_values[3] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(batch_size), MRB_SYM(symbolize_names), MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {3, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "o:", &source, &kwargs);
+  return dom_parser_parse_many(mrb, self, source, batch_size_from_kwarg(mrb, kw_values[0]), kw_values[1], kw_values[2]);
+}
+
+static mrb_value mrb_dom_document_stream_each(mrb_state *mrb, mrb_value self) {
+  mrb_value block = mrb_undef_value();
+  mrb_get_args(mrb, "|&", &block);
+  return dom_document_stream_each(mrb, self, block);
+}
+
+static mrb_value mrb_dom_document_stream_truncated_bytes(mrb_state *mrb, mrb_value self) {
+  return mrb_convert_number(mrb, mrb_cpp_get<dom::document_stream>(mrb, self)->truncated_bytes());
+}
+
+static mrb_value mrb_json_parse_each(mrb_state *mrb, mrb_value self) {
+  mrb_value source, dom_parser = mrb_undef_value(), block = mrb_undef_value();
+  mrb_value kw_values[3] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(batch_size), MRB_SYM(symbolize_names), MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {3, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "o|o:&", &source, &dom_parser, &kwargs, &block);
+  // not the default parser: the block may call JSON.parse while the stream is live
+  if (mrb_undef_p(dom_parser))
+    dom_parser = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, mrb_class_ptr(self), MRB_SYM(DomParser)), 0, NULL);
+  mrb_gc_protect(mrb, dom_parser);
+  mrb_value stream_obj = dom_parser_parse_many(mrb, dom_parser, source, batch_size_from_kwarg(mrb, kw_values[0]), kw_values[1], kw_values[2]);
+  mrb_value result = dom_document_stream_each(mrb, stream_obj, block);
+  return mrb_proc_p(block) ? self : result;
+}
+
+// JSON::StreamParser takes input in chunks. A byte scanner that carries its
+// state across chunks finds where each top-level value ends. Each complete
+// value is parsed straight out of the buffer by the stream's own DomParser.
+// Bytes of a value that is not finished yet stay behind and are moved to the
+// front before the next chunk is appended, so the buffer is reused instead of
+// growing. Values are handed to Ruby only after a chunk is fully scanned, so a
+// block may feed the same parser again.
+struct StreamState {
+  static constexpr size_t NO_DOC = SIZE_MAX;
+  dom::parser parser;
+  std::vector<char> buf;      // input in [0, len), at least SIMDJSON_PADDING bytes after it
+  size_t len = 0;
+  size_t consumed = 0;        // bytes of complete values, dropped on the next feed
+  size_t scan = 0;
+  size_t doc_start = NO_DOC;
+  size_t depth = 0;
+  bool in_string = false, escape = false, scalar = false;
+
+  void compact() {
+    if (consumed == 0) return;
+    std::memmove(buf.data(), buf.data() + consumed, len - consumed);
+    len -= consumed; scan -= consumed;
+    if (doc_start != NO_DOC) doc_start -= consumed;
+    consumed = 0;
+  }
+  void append(const char *p, size_t n) {
+    compact();
+    if (buf.size() < len + n + SIMDJSON_PADDING) buf.resize(len + n + SIMDJSON_PADDING);
+    std::memcpy(buf.data() + len, p, n);
+    len += n;
+  }
+  void reset() {
+    len = consumed = scan = depth = 0;
+    doc_start = NO_DOC;
+    in_string = escape = scalar = false;
+  }
+};
+
+MRB_CPP_DEFINE_TYPE(StreamState, stream_state);
+
+static inline bool stream_is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+// Parses one complete value, marking it consumed and scanned first so a
+// parse error, or a raise while converting, drops just that value and leaves
+// the scanner where the next value starts.
+static error_code stream_emit(mrb_state *mrb, StreamState *st, size_t end, mrb_value out, const ConvertOptions &opts) {
+  const size_t start = st->doc_start;
+  st->consumed = end;
+  st->scan = end;
+  st->doc_start = StreamState::NO_DOC;
+  st->scalar = false;
+  dom::element element;
+  auto code = st->parser.parse(st->buf.data() + start, end - start, false).get(element);
+  if (unlikely(code != SUCCESS)) return code;
+  JSON_STAT_ADD(mrb, bytes_parsed, end - start);
+  JSON_STAT_ADD(mrb, documents, 1);
+  int arena = mrb_gc_arena_save(mrb);
+  mrb_ary_push(mrb, out, convert_element(mrb, element, opts));
+  mrb_gc_arena_restore(mrb, arena);
+  return SUCCESS;
+}
+
+static error_code stream_scan(mrb_state *mrb, StreamState *st, mrb_value out, const ConvertOptions &opts, bool at_eof) {
+  const char *b = st->buf.data();
+  size_t i = st->scan;
+  error_code code = SUCCESS;
+  for (; i < st->len && code == SUCCESS; i++) {
+    const char c = b[i];
+    if (st->in_string) {
+      if (st->escape) st->escape = false;
+      else if (c == '\\') st->escape = true;
+      else if (c == '"') {
+        st->in_string = false;
+        if (st->depth == 0) code = stream_emit(mrb, st, i + 1, out, opts);
+      }
+    } else if (st->doc_start == StreamState::NO_DOC) {
+      if (stream_is_space(c)) { st->consumed = i + 1; continue; }
+      st->doc_start = i;
+      if (c == '{' || c == '[') st->depth = 1;
+      else if (c == '"') st->in_string = true;
+      else st->scalar = true;
+    } else if (st->scalar) {
+      if (stream_is_space(c) || c == '{' || c == '[' || c == '"') {
+        code = stream_emit(mrb, st, i, out, opts);
+        i--; // the terminator may start the next value
+      }
+    } else if (c == '"') {
+      st->in_string = true;
+    } else if (c == '{' || c == '[') {
+      st->depth++;
+    } else if (c == '}' || c == ']') {
+      if (--st->depth == 0) code = stream_emit(mrb, st, i + 1, out, opts);
+    }
+  }
+  st->scan = i;
+  if (code != SUCCESS || !at_eof || st->doc_start == StreamState::NO_DOC) return code;
+  if (st->scalar) return stream_emit(mrb, st, st->len, out, opts);
+  code = st->in_string ? UNCLOSED_STRING : INCOMPLETE_ARRAY_OR_OBJECT;
+  st->reset();
+  return code;
+}
+
+static mrb_value stream_feed(mrb_state *mrb, mrb_value self, const char *p, mrb_int n, bool at_eof) {
+  StreamState *st = mrb_cpp_get<StreamState>(mrb, self);
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  convert_options_from_kwargs(mrb, mrb_iv_get(mrb, self, MRB_SYM(symbolize_names)),
+                              mrb_iv_get(mrb, self, MRB_SYM(cache_keys)), opts, key_cache);
+  mrb_value out = mrb_ary_new(mrb);
+  mrb_gc_protect(mrb, out);
+  if (n > 0) st->append(p, static_cast<size_t>(n));
+  auto code = stream_scan(mrb, st, out, opts, at_eof);
+  mrb_value block = mrb_iv_get(mrb, self, MRB_SYM(block));
+  if (mrb_proc_p(block)) {
+    int arena = mrb_gc_arena_save(mrb);
+    for (mrb_int i = 0; i < RARRAY_LEN(out); i++) {
+      mrb_yield(mrb, block, RARRAY_PTR(out)[i]);
+      mrb_gc_arena_restore(mrb, arena);
+    }
+  }
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  return out;
+}
+
+static mrb_value mrb_json_stream_parser_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value block = mrb_nil_value();
+  mrb_value kw_values[2] = {mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(symbolize_names), MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {2, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, ":&", &kwargs, &block);
+  mrb_cpp_new<StreamState>(mrb, self);
+  mrb_iv_set(mrb, self, MRB_SYM(symbolize_names), mrb_bool_value(kwarg_test(kw_values[0])));
+  mrb_iv_set(mrb, self, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(kw_values[1])));
+  mrb_iv_set(mrb, self, MRB_SYM(block), block);
+  return self;
+}
+
+static mrb_value mrb_json_stream_parser_feed(mrb_state *mrb, mrb_value self) {
+  const char *p; mrb_int n;
+  mrb_get_args(mrb, "s", &p, &n);
+  return stream_feed(mrb, self, p, n, false);
+}
+
+// Without a block the parsed values would have nowhere to go.
+static mrb_value mrb_json_stream_parser_push(mrb_state *mrb, mrb_value self) {
+  const char *p; mrb_int n;
+  mrb_get_args(mrb, "s", &p, &n);
+  if (unlikely(!mrb_proc_p(mrb_iv_get(mrb, self, MRB_SYM(block)))))
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "JSON::StreamParser#<< needs a block; use feed to get the values");
+  stream_feed(mrb, self, p, n, false);
+  return self;
+}
+
+static mrb_value mrb_json_stream_parser_finish(mrb_state *mrb, mrb_value self) {
+  return stream_feed(mrb, self, NULL, 0, true);
+}
+
+static mrb_value mrb_json_stream_parser_buffered_bytes(mrb_state *mrb, mrb_value self) {
+  StreamState *st = mrb_cpp_get<StreamState>(mrb, self);
+  return mrb_convert_number(mrb, st->len - st->consumed);
+}
+
+static mrb_value mrb_json_stream_parser_reset(mrb_state *mrb, mrb_value self) {
+  mrb_cpp_get<StreamState>(mrb, self)->reset();
+  return self;
+}
+
+static mrb_value mrb_ondemand_document_stream_each(mrb_state *mrb, mrb_value self) {
+  mrb_value block = mrb_undef_value();
+  mrb_get_args(mrb, "|&", &block);
+  auto *stream = mrb_cpp_get<ondemand::document_stream>(mrb, self);
+  DocumentConvert conv(mrb, self);
+  mrb_value ary = mrb_undef_value();
+  if (!mrb_proc_p(block)) { ary = mrb_ary_new(mrb); mrb_gc_protect(mrb, ary); }
+  int arena = mrb_gc_arena_save(mrb);
+  for (auto result : *stream) {
+    ondemand::document_reference doc;
+    auto code = result.get(doc);
+    if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+    mrb_value val = convert_ondemand_document_to_mrb(mrb, doc, conv.opts);
+    if (mrb_undef_p(ary)) mrb_yield(mrb, block, val); else mrb_ary_push(mrb, ary, val);
+    mrb_gc_arena_restore(mrb, arena);
+  }
+  return mrb_undef_p(ary) ? self : ary;
+}
+
+static mrb_value mrb_ondemand_document_stream_truncated_bytes(mrb_state *mrb, mrb_value self) {
+  return mrb_convert_number(mrb, mrb_cpp_get<ondemand::document_stream>(mrb, self)->truncated_bytes());
+}
+
+static mrb_value mrb_ondemand_parser_iterate_many(mrb_state *mrb, mrb_value self) {
+  mrb_value source, block = mrb_undef_value();
+  mrb_value kw_values[2] = {mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(batch_size), MRB_SYM(cache_keys)};
+  mrb_kwargs kwargs = {2, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "o:&", &source, &kwargs, &block);
+  size_t batch_size = batch_size_from_kwarg(mrb, kw_values[0]);
+  struct RClass *json_mod = json_state(mrb)->json_mod;
+  mrb_value view_obj = make_padded_string_view_from_mrb_value(mrb, source);
+  mrb_gc_protect(mrb, view_obj);
+  mrb_value stream_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_mod, MRB_SYM(OndemandDocumentStream)), 0, NULL);
+  mrb_gc_protect(mrb, stream_obj);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(view), view_obj);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(parser), self);
+  mrb_iv_set(mrb, stream_obj, MRB_SYM(cache_keys), mrb_bool_value(kwarg_test(kw_values[1])));
+  auto *view   = mrb_cpp_get<padded_string_view>(mrb, view_obj);
+  auto *parser = mrb_cpp_get<ondemand::parser>(mrb, self);
+  auto *stream = mrb_cpp_new<ondemand::document_stream>(mrb, stream_obj);
+  auto code = parser->iterate_many(*view, batch_size).get(*stream);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  if (!mrb_proc_p(block)) return stream_obj;
+  mrb_funcall_with_block(mrb, stream_obj, MRB_SYM(each), 0, NULL, block);
+  return self;
+}
+
+// ============================================================================
+// MrubyDeserialize — uses mrb_net_check_type with Ruby classes
+//
+// Schema stores { :@ivar => SomeClass } where SomeClass is a Ruby Class or
+// Module. The schema is compiled once per class into an IntoPlan (stripped
+// key, ivar sym and expected class per field), kept in a hidden ivar on the
+// class. Document#into then walks the JSON object once, front to back, and
+// matches each key against the plan; no per-call name lookups and no
+// out-of-order field searches. What each schema class accepts is worked out
+// once with mrb_net_check_type (which does is_a? via mrb_obj_is_kind_of), so
+// values are type-checked before they are converted. Classes that have a
+// schema themselves, alone or as [ItemClass], are filled recursively.
+// ============================================================================
+
+// What a JSON value turns into, as one bit each, so a plan field can say up
+// front which JSON values its schema class would accept.
+enum IntoKind : uint8_t {
+  INTO_STRING  = 1 << 0, INTO_INTEGER = 1 << 1, INTO_FLOAT = 1 << 2, INTO_ARRAY = 1 << 3,
+  INTO_OBJECT  = 1 << 4, INTO_TRUE    = 1 << 5, INTO_FALSE = 1 << 6, INTO_NULL  = 1 << 7,
+};
+
+// One schema value, classified. `klass` is set for Class types: if that
+// class carries a schema of its own when a JSON object arrives, the object
+// becomes a new instance filled through the same plan machinery instead of a
+// Hash. The nested schema is looked up at that point, not at compile time,
+// so adding or dropping it later is noticed.
+struct IntoType {
+  mrb_value type = mrb_nil_value(); // kept alive by the plan object, see into_plan_for()
+  uint8_t accepts = 0;              // IntoKind bits, valid unless generic
+  bool generic = true;              // not a Class/Module: convert, then check
+  struct RClass *klass = nullptr;
+};
+
+// Value writer JSON.dump picks for a schema field whose type admits only
+// one kind of value; anything else, or a value that breaks the schema, goes
+// through the generic encoder.
+enum DumpKind : uint8_t { DUMP_ANY, DUMP_STRING, DUMP_INTEGER, DUMP_FLOAT };
+
+class IntoPlan {
+public:
+  struct Field {
+    std::string key;     // ivar name without the leading '@'
+    mrb_sym ivar;
+    mrb_value type;      // the raw schema value, for matches()
+    IntoType spec;
+    bool array_of = false; // schema value was [ItemClass]
+    IntoType item;         // element type when array_of
+    std::string dump_key;  // ,"key": escaped once for JSON.dump
+    DumpKind dump_kind = DUMP_ANY;
+  };
+
+  std::vector<Field> fields;
+  mrb_value schema = mrb_nil_value();
+  uint64_t checked_epoch = 0; // JsonState::plan_epoch of the last matches()
+
+  // A plan stays valid while the class still returns the very same schema
+  // hash with the same entries in the same order.
+  bool matches(mrb_state *mrb, mrb_value current) const {
+    if (!mrb_obj_eq(mrb, schema, current) ||
+        mrb_hash_size(mrb, current) != static_cast<mrb_int>(fields.size()))
+      return false;
+    struct Ctx { const IntoPlan *plan; size_t i; bool same; } ctx{this, 0, true};
+    mrb_hash_foreach(mrb, mrb_hash_ptr(current),
+      [](mrb_state *mrb, mrb_value key, mrb_value type, void *data) -> int {
+        auto *ctx = static_cast<Ctx *>(data);
+        const Field &f = ctx->plan->fields[ctx->i++];
+        ctx->same = mrb_symbol_p(key) && mrb_symbol(key) == f.ivar && mrb_obj_eq(mrb, type, f.type);
+        return ctx->same ? 0 : 1;
+      }, &ctx);
+    return ctx.same;
+  }
+
+  // Plans are compiled once and never changed afterwards; a new schema gets
+  // a new plan, see into_plan_for(). Every type the plan refers to is pushed
+  // onto `types` as well, so it stays reachable after the schema changes.
+  error_code compile(mrb_state *mrb, mrb_value current, mrb_value types) {
+    schema = current;
+    struct Ctx { IntoPlan *plan; mrb_value types; error_code err; } ctx{this, types, SUCCESS};
+    mrb_hash_foreach(mrb, mrb_hash_ptr(current),
+      [](mrb_state *mrb, mrb_value key, mrb_value type, void *data) -> int {
+        auto *ctx = static_cast<Ctx *>(data);
+        if (unlikely(!mrb_symbol_p(key))) { ctx->err = INCORRECT_TYPE; return 1; }
+        mrb_int len;
+        const char *str = mrb_sym_name_len(mrb, mrb_symbol(key), &len);
+        if (unlikely(!str)) { ctx->err = UNEXPECTED_ERROR; return 1; }
+        std::string_view sv(str, len);
+        while (!sv.empty() && sv[0] == '@') sv.remove_prefix(1);
+        Field f{std::string(sv), mrb_symbol(key), type};
+        builder::string_builder sb;
+        sb.append_comma();
+        sb.escape_and_append_with_quotes(sv);
+        sb.append_colon();
+        f.dump_key = std::string(std::string_view(sb.view()));
+        f.spec.type = type;
+        mrb_ary_push(mrb, ctx->types, type);
+        if (mrb_array_p(type) && RARRAY_LEN(type) == 1) {
+          f.array_of = true;
+          f.item.type = mrb_ary_ref(mrb, type, 0);
+          mrb_ary_push(mrb, ctx->types, f.item.type);
+        }
+        ctx->plan->fields.push_back(std::move(f));
+        return 0;
+      }, &ctx);
+    if (unlikely(ctx.err != SUCCESS)) { fields.clear(); schema = mrb_nil_value(); return ctx.err; }
+    classify(mrb);
+    return SUCCESS;
+  }
+
+  // Asks mrb_net_check_type once per JSON kind with a sample of what that
+  // kind converts to, so Document#into can reject a mismatch before
+  // converting anything.
+  void classify(mrb_state *mrb) {
+    int arena = mrb_gc_arena_save(mrb);
+    const std::pair<uint8_t, mrb_value> samples[] = {
+      {INTO_STRING,  mrb_str_new(mrb, NULL, 0)},
+      {INTO_INTEGER, mrb_convert_number(mrb, static_cast<int64_t>(0))},
+#ifndef MRB_NO_FLOAT
+      {INTO_FLOAT,   mrb_convert_number(mrb, 0.0)},
+#endif
+      {INTO_ARRAY,   mrb_ary_new(mrb)},
+      {INTO_OBJECT,  mrb_hash_new(mrb)},
+      {INTO_TRUE,    mrb_true_value()},
+      {INTO_FALSE,   mrb_false_value()},
+      {INTO_NULL,    mrb_nil_value()},
+    };
+    auto classify_type = [mrb, &samples](IntoType &t) {
+      switch (mrb_type(t.type)) {
+        case MRB_TT_CLASS: case MRB_TT_MODULE: case MRB_TT_SCLASS: {
+          t.generic = false;
+          t.accepts = 0;
+          for (const auto &sample : samples)
+            if (mrb_net_check_type(mrb, t.type, sample.second)) t.accepts |= sample.first;
+          t.klass = mrb_type(t.type) == MRB_TT_CLASS ? mrb_class_ptr(t.type) : nullptr;
+        } break;
+        default:
+          t.generic = true;
+          t.klass = nullptr;
+          break;
+      }
+    };
+    for (Field &f : fields) {
+      if (f.array_of) {
+        f.spec.generic = false;
+        f.spec.accepts = INTO_ARRAY;
+        classify_type(f.item);
+      } else {
+        classify_type(f.spec);
+      }
+      f.dump_kind = DUMP_ANY;
+      if (!f.spec.generic) {
+        switch (f.spec.accepts) {
+          case INTO_STRING:  f.dump_kind = DUMP_STRING; break;
+          case INTO_INTEGER: f.dump_kind = DUMP_INTEGER; break;
+#ifndef MRB_NO_FLOAT
+          case INTO_FLOAT:   f.dump_kind = DUMP_FLOAT; break;
+#endif
+          default: break;
+        }
+      }
+    }
+    mrb_gc_arena_restore(mrb, arena);
+  }
+
+  // Fields usually arrive in schema order, so the search starts right after
+  // the previous match and wraps around.
+  Field *find(std::string_view key, size_t &hint) {
+    const size_t n = fields.size();
+    for (size_t k = 0; k < n; ++k) {
+      size_t i = hint + k; if (i >= n) i -= n;
+      if (fields[i].key == key) { hint = i + 1; return &fields[i]; }
+    }
+    return nullptr;
+  }
+};
+
+MRB_CPP_DEFINE_TYPE(IntoPlan, into_plan);
+
+// The plan object holds the schema hash and the types compiled from it in
+// ivars, which keeps every mrb_value cached in the plan reachable for the
+// GC even once the hash has been changed. When the schema has
+// changed a fresh plan replaces the cached one instead of being recompiled
+// in place, and the returned plan is pinned in the GC arena: a caller that
+// runs Ruby code (initialize, as_json) while walking the fields keeps a valid
+// plan even if that code redefines the schema. Callers bracket the call with
+// mrb_gc_arena_save/restore. The entry-by-entry comparison with the schema
+// runs once per class and epoch; after that the same hash with the same
+// size counts as unchanged, so an entry replaced in the middle of a dump or
+// into call is picked up by the next call.
+static IntoPlan *into_plan_for(mrb_state *mrb, JsonState *state, struct RClass *klass, mrb_value schema, error_code &err) {
+  const uint64_t epoch = state->plan_epoch;
+  mrb_value klass_obj = mrb_obj_value(klass);
+  mrb_value plan_obj = mrb_iv_get(mrb, klass_obj, MRB_SYM(json_into_plan));
+  if (likely(!mrb_nil_p(plan_obj))) {
+    IntoPlan *plan = mrb_cpp_get<IntoPlan>(mrb, plan_obj);
+    const bool same = plan->checked_epoch == epoch && mrb_obj_eq(mrb, plan->schema, schema) &&
+                      mrb_hash_size(mrb, schema) == static_cast<mrb_int>(plan->fields.size());
+    if (likely(same || plan->matches(mrb, schema))) {
+      plan->checked_epoch = epoch;
+      mrb_gc_protect(mrb, plan_obj);
+      return plan;
+    }
+  }
+  plan_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, state->json_mod, MRB_SYM(IntoPlan)), 0, NULL);
+  IntoPlan *plan = mrb_cpp_new<IntoPlan>(mrb, plan_obj);
+  mrb_value types = mrb_ary_new(mrb);
+  mrb_iv_set(mrb, plan_obj, MRB_SYM(schema), schema);
+  mrb_iv_set(mrb, plan_obj, MRB_SYM(types), types);
+  err = plan->compile(mrb, schema, types);
+  if (unlikely(err != SUCCESS)) return nullptr;
+  plan->checked_epoch = epoch;
+  mrb_iv_set(mrb, klass_obj, MRB_SYM(json_into_plan), plan_obj);
+  return plan;
+}
+
+// The class a JSON object for `t` should become, if any: a Class whose
+// schema is, right now, a non-empty Hash.
+static inline struct RClass *into_nested_class(mrb_state *mrb, const IntoType &t) {
+  if (!t.klass) return nullptr;
+  mrb_value schema = mrb_net_schema(mrb, t.klass);
+  return mrb_hash_p(schema) && mrb_hash_size(mrb, schema) > 0 ? t.klass : nullptr;
+}
+
+class MrubyDeserialize {
+public:
+  mrb_state *mrb;
+  mrb_value into;
+  JsonState *state; // resolved once per into call, shared by nested objects
+
+  MrubyDeserialize(mrb_state *mrb, mrb_value into, JsonState *state) : mrb(mrb), into(into), state(state) {}
+
+  // Sets the ivar if the type matches, INCORRECT_TYPE otherwise (caller stops).
+  error_code validate_and_set_field(const IntoPlan::Field &field, ondemand::value &json_field) {
+    mrb_value ruby_value;
+    auto err = field.array_of ? convert_array_of(field.item, json_field, ruby_value)
+                              : convert_typed(field.spec, json_field, ruby_value);
+    if (likely(err == SUCCESS)) mrb_iv_set(mrb, into, field.ivar, ruby_value);
+    return err;
+  }
+
+  // The JSON type is checked against the plan before anything is converted.
+  error_code convert_typed(const IntoType &t, ondemand::value &json_field, mrb_value &out);
+  error_code convert_array_of(const IntoType &item, ondemand::value &json_field, mrb_value &out);
+};
+
+namespace simdjson {
+
+// Fields not in the schema are skipped, schema fields missing from the
+// document are left alone (whitelist model), duplicate keys: first wins.
+// Which fields were set is tracked per call, in a bit mask or, past 64
+// fields, a GC-owned scratch String, so a class nested in itself does not
+// clobber its parent's state.
+static error_code into_fill(mrb_state *mrb, IntoPlan *plan, ondemand::object &obj, MrubyDeserialize &mruby) {
+  const size_t n = plan->fields.size();
+  uint64_t seen_mask = 0;
+  uint8_t *seen_bytes = nullptr;
+  if (unlikely(n > 64)) {
+    mrb_value scratch = mrb_str_new(mrb, NULL, static_cast<mrb_int>(n));
+    mrb_gc_protect(mrb, scratch);
+    seen_bytes = reinterpret_cast<uint8_t *>(RSTRING_PTR(scratch));
+    memset(seen_bytes, 0, n);
+  }
+  size_t hint = 0;
+  for (auto field : obj) {
+    std::string_view k;
+    auto err = field.escaped_key().get(k);
+    if (unlikely(err != SUCCESS)) return err;
+    IntoPlan::Field *f = plan->find(k, hint);
+    if (!f) continue;
+    const size_t i = static_cast<size_t>(f - plan->fields.data());
+    if (likely(!seen_bytes)) {
+      if (seen_mask & (uint64_t{1} << i)) continue;
+      seen_mask |= uint64_t{1} << i;
+    } else {
+      if (seen_bytes[i]) continue;
+      seen_bytes[i] = 1;
+    }
+    ondemand::value v;
+    err = field.value().get(v);
+    if (likely(err == SUCCESS)) err = mruby.validate_and_set_field(*f, v);
+    if (unlikely(err != SUCCESS)) return err;
+  }
+  return SUCCESS;
+}
+
+template <typename simdjson_value>
+auto tag_invoke(deserialize_tag, simdjson_value &val, MrubyDeserialize& mruby) {
+  ondemand::object obj;
+  auto err = val.get_object().get(obj);
+  if (unlikely(err != SUCCESS)) return err;
+
+  mrb_state *mrb = mruby.mrb;
+  struct RClass *klass = mrb_class(mrb, mruby.into);
+  mrb_value schema = mrb_net_schema(mrb, klass);
+  if (unlikely(!mrb_hash_p(schema))) return INCORRECT_TYPE;
+  // Values land in ivars of `into`, which the caller keeps alive, so
+  // everything pinned below can go once the object is filled.
+  int arena = mrb_gc_arena_save(mrb);
+  IntoPlan *plan = into_plan_for(mrb, mruby.state, klass, schema, err);
+  if (likely(plan)) err = into_fill(mrb, plan, obj, mruby);
+  mrb_gc_arena_restore(mrb, arena);
+  return err;
+}
+
+} // namespace simdjson
+
+error_code MrubyDeserialize::convert_typed(const IntoType &t, ondemand::value &json_field, mrb_value &out) {
+  if (unlikely(t.generic)) {
+    out = convert_ondemand_value_to_mrb(mrb, json_field, ConvertOptions{});
+    mrb_gc_protect(mrb, out);
+    return likely(mrb_net_check_type(mrb, t.type, out)) ? SUCCESS : INCORRECT_TYPE;
+  }
+
+  ondemand::json_type type;
+  auto err = json_field.type().get(type);
+  if (unlikely(err != SUCCESS)) return err;
+  uint8_t kind;
+  bool boolean = false;
+  switch (type) {
+    case ondemand::json_type::object: kind = INTO_OBJECT; break;
+    case ondemand::json_type::array:  kind = INTO_ARRAY; break;
+    case ondemand::json_type::string: kind = INTO_STRING; break;
+    case ondemand::json_type::number: {
+      ondemand::number_type nt;
+      err = json_field.get_number_type().get(nt);
+      if (unlikely(err != SUCCESS)) return err;
+      kind = nt == ondemand::number_type::floating_point_number ? INTO_FLOAT : INTO_INTEGER;
+    } break;
+    case ondemand::json_type::boolean:
+      err = json_field.get_bool().get(boolean);
+      if (unlikely(err != SUCCESS)) return err;
+      kind = boolean ? INTO_TRUE : INTO_FALSE;
+      break;
+    case ondemand::json_type::null: kind = INTO_NULL; break;
+    default: return INCORRECT_TYPE;
+  }
+
+  struct RClass *nested_class = kind == INTO_OBJECT ? into_nested_class(mrb, t) : nullptr;
+  if (nested_class) {
+    out = mrb_obj_new(mrb, nested_class, 0, NULL);
+    mrb_gc_protect(mrb, out);
+    MrubyDeserialize nested(mrb, out, state);
+    return json_field.get(nested);
+  }
+  if (!(t.accepts & kind)) return INCORRECT_TYPE;
+
+  switch (kind) {
+    case INTO_STRING:  out = convert_string_from_ondemand(mrb, json_field); break;
+    case INTO_INTEGER:
+    case INTO_FLOAT:   out = convert_number_from_ondemand(mrb, json_field, ConvertOptions{}); break;
+    case INTO_TRUE:
+    case INTO_FALSE:   out = mrb_bool_value(boolean); break;
+    case INTO_NULL:    out = mrb_nil_value(); break;
+    default:           out = convert_ondemand_value_to_mrb(mrb, json_field, ConvertOptions{}); break;
+  }
+  return SUCCESS;
+}
+
+error_code MrubyDeserialize::convert_array_of(const IntoType &item, ondemand::value &json_field, mrb_value &out) {
+  ondemand::array arr;
+  auto err = json_field.get_array().get(arr);
+  if (unlikely(err != SUCCESS)) return err;
+  out = mrb_ary_new(mrb);
+  mrb_gc_protect(mrb, out);
+  int arena = mrb_gc_arena_save(mrb);
+  for (auto element : arr) {
+    ondemand::value v;
+    err = element.get(v);
+    mrb_value val;
+    if (likely(err == SUCCESS)) err = convert_typed(item, v, val);
+    if (unlikely(err != SUCCESS)) return err;
+    mrb_ary_push(mrb, out, val);
+    mrb_gc_arena_restore(mrb, arena);
+  }
+  return SUCCESS;
+}
+
+static mrb_value mrb_document_deserialize(mrb_state *mrb, mrb_value self) {
   mrb_value into;
   mrb_get_args(mrb, "o", &into);
-  MrubyDeserialize mruby(mrb, into);
-  ondemand::document *doc = mrb_cpp_get<ondemand::document>(mrb, self);
+  JsonState *state = json_state(mrb);
+  state->plan_epoch++;
+  MrubyDeserialize mruby(mrb, into, state);
+  ondemand::document *doc = mrb_json_doc_get(mrb, self);
   auto code = doc->get(mruby);
   if (likely(code == SUCCESS)) return into;
   raise_simdjson_error(mrb, code);
@@ -910,78 +3490,781 @@ static inline void json_encode_false_type(mrb_value v, builder::string_builder &
   if (mrb_nil_p(v)) json_encode_nil(builder); else json_encode_false(builder);
 }
 static inline void json_encode_true(builder::string_builder &builder) { builder.append(true); }
-static inline void json_encode_string(mrb_value v, builder::string_builder &builder) {
+// Only String/Symbol payloads can carry invalid UTF-8, so they are validated
+// one by one here instead of rescanning the whole output afterwards. Strings
+// mruby already knows to be ASCII-only skip the check entirely.
+static inline bool json_string_valid_utf8(mrb_value v) {
+#ifdef MRB_UTF8_STRING
+  if (RSTR_ASCII_P(RSTRING(v))) return true;
+#endif
+  return simdjson::validate_utf8(RSTRING_PTR(v), RSTRING_LEN(v));
+}
+static inline void json_encode_string(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+  if (unlikely(!json_string_valid_utf8(v)))
+    mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");
   builder.escape_and_append_with_quotes(std::string_view(RSTRING_PTR(v), RSTRING_LEN(v)));
 }
 static inline void json_encode_symbol(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
-  json_encode_string(mrb_sym_str(mrb, mrb_symbol(v)), builder);
+  json_encode_string(mrb, mrb_sym_str(mrb, mrb_symbol(v)), builder);
 }
 #ifndef MRB_NO_FLOAT
 static inline void json_encode_float(mrb_value v, builder::string_builder &builder) { builder.append(mrb_float(v)); }
 #endif
 static inline void json_encode_integer(mrb_value v, builder::string_builder &builder) { builder.append(mrb_integer(v)); }
 
-struct DumpHashCtx { builder::string_builder &builder; bool first; };
-static void json_encode(mrb_state *mrb, mrb_value v, builder::string_builder &builder);
+// Where JSON.dump(obj, io) / JSON.dump(obj, into: buf) send their output.
+// The builder is drained into the target whenever it grows past DUMP_CHUNK_SIZE,
+// so it never holds much more than one chunk (plus the scalar that crossed the
+// line). Flushes only happen between array elements and object members.
+struct DumpSink {
+  static constexpr size_t DUMP_CHUNK_SIZE = 64 * 1024;
+  mrb_value target;
+  bool is_io;
+};
+
+static void dump_sink_write(mrb_state *mrb, DumpSink *sink, std::string_view sv) {
+  if (sink->is_io) {
+    int arena_index = mrb_gc_arena_save(mrb);
+    mrb_funcall_id(mrb, sink->target, MRB_SYM(write), 1, mrb_str_new(mrb, sv.data(), sv.size()));
+    mrb_gc_arena_restore(mrb, arena_index);
+  } else {
+    mrb_str_cat(mrb, sink->target, sv.data(), sv.size());
+  }
+}
+
+static void dump_sink_flush(mrb_state *mrb, builder::string_builder &builder, DumpSink *sink) {
+  if (builder.size() == 0) return;
+  std::string_view sv = builder.view();
+  dump_sink_write(mrb, sink, sv);
+  builder.clear();
+}
+
+static inline void dump_sink_maybe_flush(mrb_state *mrb, builder::string_builder &builder, DumpSink *sink) {
+  if (sink && builder.size() >= DumpSink::DUMP_CHUNK_SIZE) dump_sink_flush(mrb, builder, sink);
+}
+
+// JSON::Raw holds JSON text that is emitted byte for byte. The text is
+// trusted, not reparsed, so the caller vouches for it being valid JSON.
+// A subclass that skipped super, or an allocated but never initialized Raw,
+// has no text to emit.
+static inline void json_encode_raw(mrb_state *mrb, mrb_value raw, builder::string_builder &builder) {
+  mrb_value json = mrb_iv_get(mrb, raw, MRB_SYM(json));
+  if (unlikely(!mrb_string_p(json)))
+    mrb_raise(mrb, E_TYPE_ERROR, "JSON::Raw has no JSON text; did initialize call super?");
+  builder.append_raw(std::string_view(RSTRING_PTR(json), RSTRING_LEN(json)));
+}
+
+static mrb_value mrb_json_raw_initialize(mrb_state *mrb, mrb_value self) {
+  mrb_value json;
+  mrb_get_args(mrb, "S", &json);
+  if (!mrb_frozen_p(mrb_obj_ptr(json))) json = mrb_obj_freeze(mrb, mrb_str_dup(mrb, json));
+  mrb_iv_set(mrb, self, MRB_SYM(json), json);
+  return self;
+}
+
+static mrb_value mrb_json_raw_to_s(mrb_state *mrb, mrb_value self) {
+  return mrb_iv_get(mrb, self, MRB_SYM(json));
+}
+
+// Output layout of an encode. CompactStyle is the default and has nothing
+// to decide at run time. Every styled check below sits behind
+// `if constexpr (Style::styled)`, so the compact instantiation contains no
+// branch for it. DumpStyle carries the JSON.dump / pretty_generate options.
+// Both carry the JsonState the entry point resolved, so the encoder never
+// looks it up per value.
+struct CompactStyle {
+  static constexpr bool styled = false;
+  JsonState *state;
+};
+
+struct DumpStyle {
+  static constexpr bool styled = true;
+  JsonState *state = nullptr;
+  std::string_view indent;
+  bool ascii_only = false;
+  bool escape_slash = false;
+  size_t depth = 0;
+};
+
+// Bytes of a word that a styled string must escape: controls, '"', '\\',
+// and optionally '/' and non-ASCII. Eight bytes are tested per step (SWAR),
+// and clean words are skipped whole.
+static inline uint64_t styled_escape_mask(uint64_t w, bool ascii_only, bool escape_slash) {
+  constexpr uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+  auto has_byte = [](uint64_t x, unsigned char c) {
+    const uint64_t y = x ^ (ones * c);
+    return (y - ones) & ~y & highs;
+  };
+  uint64_t mask = ((w - ones * 0x20) & ~w & highs) | has_byte(w, '"') | has_byte(w, '\\');
+  if (escape_slash) mask |= has_byte(w, '/');
+  if (ascii_only) mask |= w & highs;
+  return mask;
+}
+
+static inline bool styled_needs_escape(unsigned char c, const DumpStyle &style) {
+  return c < 0x20 || c == '"' || c == '\\' || (style.escape_slash && c == '/') || (style.ascii_only && c >= 0x80);
+}
+
+static inline void styled_append_u(builder::string_builder &builder, uint32_t cp) {
+  static const char hex[] = "0123456789abcdef";
+  const char out[6] = {'\\', 'u', hex[(cp >> 12) & 0xF], hex[(cp >> 8) & 0xF], hex[(cp >> 4) & 0xF], hex[cp & 0xF]};
+  builder.append_raw(out, sizeof(out));
+}
+
+// Escapes one special byte, or the whole UTF-8 sequence it starts, and
+// returns how many input bytes it used. Input is already valid UTF-8.
+static inline size_t styled_escape_at(builder::string_builder &builder, const unsigned char *p) {
+  switch (p[0]) {
+    case '"':  builder.append_raw("\\\"", 2); return 1;
+    case '\\': builder.append_raw("\\\\", 2); return 1;
+    case '/':  builder.append_raw("\\/", 2); return 1;
+    case '\b': builder.append_raw("\\b", 2); return 1;
+    case '\f': builder.append_raw("\\f", 2); return 1;
+    case '\n': builder.append_raw("\\n", 2); return 1;
+    case '\r': builder.append_raw("\\r", 2); return 1;
+    case '\t': builder.append_raw("\\t", 2); return 1;
+    default: break;
+  }
+  if (p[0] < 0x80) { styled_append_u(builder, p[0]); return 1; }
+  uint32_t cp; size_t n;
+  if (p[0] < 0xE0)      { cp = p[0] & 0x1F; n = 2; }
+  else if (p[0] < 0xF0) { cp = p[0] & 0x0F; n = 3; }
+  else                  { cp = p[0] & 0x07; n = 4; }
+  for (size_t i = 1; i < n; i++) cp = (cp << 6) | (p[i] & 0x3F);
+  if (cp >= 0x10000) {
+    cp -= 0x10000;
+    styled_append_u(builder, 0xD800 + (cp >> 10));
+    styled_append_u(builder, 0xDC00 + (cp & 0x3FF));
+  } else {
+    styled_append_u(builder, cp);
+  }
+  return n;
+}
+
+static void json_encode_string_styled(mrb_state *mrb, mrb_value v, builder::string_builder &builder, const DumpStyle &style) {
+  if (unlikely(!json_string_valid_utf8(v)))
+    mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");
+  if (!style.ascii_only && !style.escape_slash) {
+    builder.escape_and_append_with_quotes(std::string_view(RSTRING_PTR(v), RSTRING_LEN(v)));
+    return;
+  }
+  const auto *p = reinterpret_cast<const unsigned char *>(RSTRING_PTR(v));
+  const size_t n = RSTRING_LEN(v);
+  size_t i = 0, run = 0;
+  builder.append('"');
+  while (i < n) {
+    if (i + 8 <= n) {
+      uint64_t w;
+      std::memcpy(&w, p + i, 8);
+      if (!styled_escape_mask(w, style.ascii_only, style.escape_slash)) { i += 8; continue; }
+    }
+    if (!styled_needs_escape(p[i], style)) { i++; continue; }
+    if (i > run) builder.append_raw(reinterpret_cast<const char *>(p + run), i - run);
+    i += styled_escape_at(builder, p + i);
+    run = i;
+  }
+  if (n > run) builder.append_raw(reinterpret_cast<const char *>(p + run), n - run);
+  builder.append('"');
+}
+
+template <typename Style>
+static inline void json_encode_string_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, const Style &style) {
+  if constexpr (Style::styled) json_encode_string_styled(mrb, v, builder, style);
+  else json_encode_string(mrb, v, builder);
+}
 
+template <typename Style>
+static inline void json_encode_newline(builder::string_builder &builder, const Style &style) {
+  if constexpr (Style::styled) {
+    if (style.indent.empty()) return;
+    builder.append('\n');
+    for (size_t i = 0; i < style.depth; i++) builder.append_raw(style.indent);
+  }
+}
+
+template <typename Style>
+static void json_encode_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style);
+
+template <typename Style>
+struct DumpHashCtx { builder::string_builder &builder; DumpSink *sink; Style &style; bool first; };
+
+// Symbol keys are escaped from the symbol table once and then copied from
+// JsonState::sym_keys, so dumping symbolize_names data allocates nothing per
+// key.
+static std::string_view json_symbol_key(mrb_state *mrb, JsonState *state, mrb_sym sym) {
+  if (unlikely(state->sym_keys.empty())) state->sym_keys.resize(JsonState::SYM_KEY_SLOTS);
+  JsonState::SymKey &slot = state->sym_keys[sym & (JsonState::SYM_KEY_SLOTS - 1)];
+  if (likely(slot.sym == sym)) return slot.json;
+  mrb_int len;
+  const char *name = mrb_sym_name_len(mrb, sym, &len);
+  if (unlikely(!simdjson::validate_utf8(name, len)))
+    mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");
+  builder::string_builder sb;
+  sb.escape_and_append_with_quotes(std::string_view(name, len));
+  slot.json.assign(std::string_view(sb.view()));
+  slot.sym = sym;
+  return slot.json;
+}
+
+template <typename Style>
+static inline void json_encode_key_as(mrb_state *mrb, mrb_value key, builder::string_builder &builder, const Style &style) {
+  if (mrb_string_p(key)) { json_encode_string_as(mrb, key, builder, style); return; }
+  if (mrb_symbol_p(key)) {
+    bool plain = true;
+    if constexpr (Style::styled) plain = !style.ascii_only && !style.escape_slash;
+    if (likely(plain)) { builder.append_raw(json_symbol_key(mrb, style.state, mrb_symbol(key))); return; }
+  }
+  json_encode_string_as(mrb, mrb_obj_as_string(mrb, key), builder, style);
+}
+
+template <typename Style>
 static int dump_hash_cb(mrb_state *mrb, mrb_value key, mrb_value val, void * const data) {
-  auto * const ctx = static_cast<DumpHashCtx *>(data);
+  auto * const ctx = static_cast<DumpHashCtx<Style> *>(data);
   if (ctx->first) ctx->first = false; else ctx->builder.append_comma();
-  json_encode(mrb, mrb_obj_as_string(mrb, key), ctx->builder);
+  json_encode_newline(ctx->builder, ctx->style);
+  json_encode_key_as(mrb, key, ctx->builder, ctx->style);
   ctx->builder.append_colon();
-  json_encode(mrb, val, ctx->builder);
+  if constexpr (Style::styled) { if (!ctx->style.indent.empty()) ctx->builder.append(' '); }
+  json_encode_as(mrb, val, ctx->builder, ctx->sink, ctx->style);
+  dump_sink_maybe_flush(mrb, ctx->builder, ctx->sink);
   return 0;
 }
 
-static void json_encode_hash(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+template <typename Style>
+static void json_encode_hash_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style) {
   builder.start_object();
-  DumpHashCtx ctx{builder, true};
-  mrb_hash_foreach(mrb, mrb_hash_ptr(v), dump_hash_cb, &ctx);
+  if constexpr (Style::styled) {
+    if (mrb_hash_size(mrb, v) == 0) { builder.end_object(); return; }
+    style.depth++;
+  }
+  DumpHashCtx<Style> ctx{builder, sink, style, true};
+  mrb_hash_foreach(mrb, mrb_hash_ptr(v), dump_hash_cb<Style>, &ctx);
+  if constexpr (Style::styled) { style.depth--; json_encode_newline(builder, style); }
   builder.end_object();
 }
 
-static void json_encode_array(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+template <typename Style>
+static void json_encode_array_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style) {
   builder.start_array();
   const mrb_int n = RARRAY_LEN(v);
   if (n > 0) {
-    json_encode(mrb, mrb_ary_ref(mrb, v, 0), builder);
-    for (mrb_int i = 1; i < n; ++i) { builder.append_comma(); json_encode(mrb, mrb_ary_ref(mrb, v, i), builder); }
+    if constexpr (Style::styled) style.depth++;
+    json_encode_newline(builder, style);
+    json_encode_as(mrb, mrb_ary_ref(mrb, v, 0), builder, sink, style);
+    dump_sink_maybe_flush(mrb, builder, sink);
+    for (mrb_int i = 1; i < n; ++i) {
+      builder.append_comma();
+      json_encode_newline(builder, style);
+      json_encode_as(mrb, mrb_ary_ref(mrb, v, i), builder, sink, style);
+      dump_sink_maybe_flush(mrb, builder, sink);
+    }
+    if constexpr (Style::styled) { style.depth--; json_encode_newline(builder, style); }
   }
   builder.end_array();
 }
 
-static void json_encode(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+// How an instance of a non-core class is dumped, in order of preference:
+// its own as_json, its own to_json (not the generic Object#to_json), its
+// native_ext_type schema, and finally to_s. Resolved the first time a class
+// shows up in a dump and kept in JsonState::dump_hooks for the rest of that
+// dump, so later objects of that class cost a slot compare instead of method
+// searches. The next dump resolves again, which picks up methods defined in
+// between.
+enum DumpHook : uint8_t { DUMP_HOOK_TO_S, DUMP_HOOK_AS_JSON, DUMP_HOOK_TO_JSON, DUMP_HOOK_SCHEMA };
+
+static DumpHook dump_hook_resolve(mrb_state *mrb, struct RClass *cls) {
+  if (mrb_obj_respond_to(mrb, cls, MRB_SYM(as_json))) return DUMP_HOOK_AS_JSON;
+  struct RClass *owner = cls;
+  mrb_method_t m = mrb_method_search_vm(mrb, &owner, MRB_SYM(to_json));
+  if (!MRB_METHOD_UNDEF_P(m) && !(MRB_METHOD_CFUNC_P(m) && MRB_METHOD_CFUNC(m) == mrb_json_dump))
+    return DUMP_HOOK_TO_JSON;
+  mrb_value schema = mrb_net_schema(mrb, cls);
+  if (mrb_hash_p(schema) && mrb_hash_size(mrb, schema) > 0) return DUMP_HOOK_SCHEMA;
+  return DUMP_HOOK_TO_S;
+}
+
+static inline DumpHook dump_hook_for(mrb_state *mrb, JsonState *state, struct RClass *cls) {
+  if (unlikely(state->dump_hooks.empty())) state->dump_hooks.resize(JsonState::HOOK_SLOTS);
+  const uintptr_t h = reinterpret_cast<uintptr_t>(cls);
+  JsonState::HookSlot &slot = state->dump_hooks[((h >> 4) ^ (h >> 12)) & (JsonState::HOOK_SLOTS - 1)];
+  if (likely(slot.cls == cls && slot.epoch == state->plan_epoch)) return static_cast<DumpHook>(slot.hook);
+  const DumpHook hook = dump_hook_resolve(mrb, cls);
+  slot.cls = cls;
+  slot.epoch = state->plan_epoch;
+  slot.hook = hook;
+  return hook;
+}
+
+template <typename Style>
+static inline void json_encode_key_sv(mrb_state *mrb, std::string_view key, builder::string_builder &builder, const Style &style) {
+  if constexpr (Style::styled) {
+    if (style.ascii_only || style.escape_slash) {
+      json_encode_string_styled(mrb, mrb_str_new(mrb, key.data(), key.size()), builder, style);
+      return;
+    }
+  }
+  builder.escape_and_append_with_quotes(key);
+}
+
+// Compact dumps reuse the class's IntoPlan: each field writes its
+// pre-escaped ,"key": and, when the schema pins the value to String, Integer
+// or Float and the ivar agrees, the value without the type switch. The plan
+// stays pinned for the whole object, so a nested as_json that redefines the
+// schema cannot pull the fields out from under it.
+static inline bool json_encode_schema_value(mrb_state *mrb, mrb_value fv, DumpKind kind, builder::string_builder &builder) {
+  switch (kind) {
+    case DUMP_STRING:  if (likely(mrb_string_p(fv)))  { json_encode_string(mrb, fv, builder); return true; } break;
+    case DUMP_INTEGER: if (likely(mrb_integer_p(fv))) { json_encode_integer(fv, builder); return true; } break;
+#ifndef MRB_NO_FLOAT
+    case DUMP_FLOAT:   if (likely(mrb_float_p(fv)))   { json_encode_float(fv, builder); return true; } break;
+#endif
+    default: break;
+  }
+  return false;
+}
+
+static bool json_encode_schema_planned(mrb_state *mrb, JsonState *state, mrb_value v, mrb_value schema, builder::string_builder &builder, DumpSink *sink) {
+  error_code err;
+  int arena = mrb_gc_arena_save(mrb);
+  IntoPlan *plan = into_plan_for(mrb, state, mrb_obj_class(mrb, v), schema, err);
+  if (unlikely(!plan)) { mrb_gc_arena_restore(mrb, arena); return false; }
+  CompactStyle style{state};
+  builder.start_object();
+  for (size_t i = 0; i < plan->fields.size(); ++i) {
+    const IntoPlan::Field &f = plan->fields[i];
+    std::string_view key = f.dump_key;
+    builder.append_raw(i == 0 ? key.substr(1) : key);
+    mrb_value fv = mrb_iv_get(mrb, v, f.ivar);
+    if (!json_encode_schema_value(mrb, fv, f.dump_kind, builder))
+      json_encode_as(mrb, fv, builder, sink, style);
+    dump_sink_maybe_flush(mrb, builder, sink);
+  }
+  builder.end_object();
+  mrb_gc_arena_restore(mrb, arena);
+  return true;
+}
+
+// Schema-bearing objects become a JSON object of their schema ivars, named
+// without the '@'.
+template <typename Style>
+static void json_encode_schema_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style) {
+  mrb_value schema = mrb_net_schema(mrb, mrb_obj_class(mrb, v));
+  if constexpr (!Style::styled) {
+    if (likely(json_encode_schema_planned(mrb, style.state, v, schema, builder, sink))) return;
+  }
+  builder.start_object();
+  if constexpr (Style::styled) style.depth++;
+  struct Ctx { mrb_value obj; builder::string_builder &builder; DumpSink *sink; Style &style; bool first; };
+  Ctx ctx{v, builder, sink, style, true};
+  mrb_hash_foreach(mrb, mrb_hash_ptr(schema),
+    [](mrb_state *mrb, mrb_value key, mrb_value, void *data) -> int {
+      auto *ctx = static_cast<Ctx *>(data);
+      if (!mrb_symbol_p(key)) return 0;
+      mrb_int len;
+      const char *name = mrb_sym_name_len(mrb, mrb_symbol(key), &len);
+      std::string_view sv(name, len);
+      while (!sv.empty() && sv[0] == '@') sv.remove_prefix(1);
+      if (ctx->first) ctx->first = false; else ctx->builder.append_comma();
+      json_encode_newline(ctx->builder, ctx->style);
+      json_encode_key_sv(mrb, sv, ctx->builder, ctx->style);
+      ctx->builder.append_colon();
+      if constexpr (Style::styled) { if (!ctx->style.indent.empty()) ctx->builder.append(' '); }
+      json_encode_as(mrb, mrb_iv_get(mrb, ctx->obj, mrb_symbol(key)), ctx->builder, ctx->sink, ctx->style);
+      dump_sink_maybe_flush(mrb, ctx->builder, ctx->sink);
+      return 0;
+    }, &ctx);
+  if constexpr (Style::styled) { style.depth--; if (!ctx.first) json_encode_newline(builder, style); }
+  builder.end_object();
+}
+
+template <typename Style>
+static void json_encode_object_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style) {
+  switch (dump_hook_for(mrb, style.state, mrb_obj_class(mrb, v))) {
+    case DUMP_HOOK_AS_JSON: {
+      mrb_value json = mrb_funcall_id(mrb, v, MRB_SYM(as_json), 0);
+      if (!mrb_obj_eq(mrb, json, v)) { json_encode_as(mrb, json, builder, sink, style); return; }
+    } break;
+    case DUMP_HOOK_TO_JSON: {
+      mrb_value json = mrb_ensure_string_type(mrb, mrb_funcall_id(mrb, v, MRB_SYM(to_json), 0));
+      // copied verbatim, so it gets the same UTF-8 check as a String value
+      if (unlikely(!json_string_valid_utf8(json)))
+        mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");
+      builder.append_raw(std::string_view(RSTRING_PTR(json), RSTRING_LEN(json)));
+    } return;
+    case DUMP_HOOK_SCHEMA: json_encode_schema_as(mrb, v, builder, sink, style); return;
+    case DUMP_HOOK_TO_S: break;
+  }
+  json_encode_string_as(mrb, mrb_obj_as_string(mrb, v), builder, style);
+}
+
+template <typename Style>
+static void json_encode_as(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink, Style &style) {
   switch (mrb_type(v)) {
     case MRB_TT_FALSE:   json_encode_false_type(v, builder); break;
     case MRB_TT_TRUE:    json_encode_true(builder); break;
-    case MRB_TT_SYMBOL:  json_encode_symbol(mrb, v, builder); break;
+    case MRB_TT_SYMBOL:  json_encode_string_as(mrb, mrb_sym_str(mrb, mrb_symbol(v)), builder, style); break;
 #ifndef MRB_NO_FLOAT
     case MRB_TT_FLOAT:   json_encode_float(v, builder); break;
 #endif
     case MRB_TT_INTEGER: json_encode_integer(v, builder); break;
-    case MRB_TT_HASH:    json_encode_hash(mrb, v, builder); break;
-    case MRB_TT_ARRAY:   json_encode_array(mrb, v, builder); break;
-    case MRB_TT_STRING:  json_encode_string(v, builder); break;
-    default:             json_encode_string(mrb_obj_as_string(mrb, v), builder); break;
+    case MRB_TT_HASH:    json_encode_hash_as(mrb, v, builder, sink, style); break;
+    case MRB_TT_ARRAY:   json_encode_array_as(mrb, v, builder, sink, style); break;
+    case MRB_TT_STRING:  json_encode_string_as(mrb, v, builder, style); break;
+    case MRB_TT_OBJECT:
+      if (mrb_obj_is_kind_of(mrb, v, style.state->raw_cls)) { json_encode_raw(mrb, v, builder); break; }
+      json_encode_object_as(mrb, v, builder, sink, style); break;
+#ifdef MRB_USE_BIGINT
+    case MRB_TT_BIGINT:  json_encode_string_as(mrb, mrb_obj_as_string(mrb, v), builder, style); break;
+#endif
+    default:             json_encode_object_as(mrb, v, builder, sink, style); break;
   }
 }
 
+static void json_encode(mrb_state *mrb, mrb_value v, builder::string_builder &builder, DumpSink *sink = nullptr) {
+  JsonState *state = json_state(mrb);
+  state->plan_epoch++;
+  CompactStyle style{state};
+  json_encode_as(mrb, v, builder, sink, style);
+}
+
+static void json_encode_hash(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+  JsonState *state = json_state(mrb);
+  state->plan_epoch++;
+  CompactStyle style{state};
+  json_encode_hash_as(mrb, v, builder, nullptr, style);
+}
+
+static void json_encode_array(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+  JsonState *state = json_state(mrb);
+  state->plan_epoch++;
+  CompactStyle style{state};
+  json_encode_array_as(mrb, v, builder, nullptr, style);
+}
+
+// Worker-side encoder for threaded dumps. It must not allocate or call into
+// the VM, so it only handles nil/true/false/Integer/Float/String and
+// String-keyed Hash/Array trees; anything else (Symbols, bigints, objects
+// needing to_s, invalid UTF-8) makes it give up so the dump is redone serially.
+struct PlainHashCtx { builder::string_builder &builder; bool first; bool ok; };
+static bool json_encode_plain(mrb_state *mrb, mrb_value v, builder::string_builder &builder);
+
+static inline bool json_encode_plain_string(mrb_value v, builder::string_builder &builder) {
+  if (unlikely(!json_string_valid_utf8(v))) return false;
+  builder.escape_and_append_with_quotes(std::string_view(RSTRING_PTR(v), RSTRING_LEN(v)));
+  return true;
+}
+
+static int plain_hash_cb(mrb_state *mrb, mrb_value key, mrb_value val, void * const data) {
+  auto * const ctx = static_cast<PlainHashCtx *>(data);
+  if (!mrb_string_p(key)) { ctx->ok = false; return 1; }
+  if (ctx->first) ctx->first = false; else ctx->builder.append_comma();
+  ctx->ok = json_encode_plain_string(key, ctx->builder);
+  if (ctx->ok) { ctx->builder.append_colon(); ctx->ok = json_encode_plain(mrb, val, ctx->builder); }
+  return ctx->ok ? 0 : 1;
+}
+
+static bool json_encode_plain(mrb_state *mrb, mrb_value v, builder::string_builder &builder) {
+  switch (mrb_type(v)) {
+    case MRB_TT_FALSE:   json_encode_false_type(v, builder); return true;
+    case MRB_TT_TRUE:    json_encode_true(builder); return true;
+#ifndef MRB_NO_FLOAT
+    case MRB_TT_FLOAT:   json_encode_float(v, builder); return true;
+#endif
+    case MRB_TT_INTEGER: json_encode_integer(v, builder); return true;
+    case MRB_TT_STRING:  return json_encode_plain_string(v, builder);
+    case MRB_TT_HASH: {
+      builder.start_object();
+      PlainHashCtx ctx{builder, true, true};
+      mrb_hash_foreach(mrb, mrb_hash_ptr(v), plain_hash_cb, &ctx);
+      builder.end_object();
+      return ctx.ok;
+    }
+    case MRB_TT_ARRAY: {
+      builder.start_array();
+      const mrb_int n = RARRAY_LEN(v);
+      for (mrb_int i = 0; i < n; ++i) {
+        if (i > 0) builder.append_comma();
+        if (!json_encode_plain(mrb, mrb_ary_ref(mrb, v, i), builder)) return false;
+      }
+      builder.end_array();
+      return true;
+    }
+    default: return false;
+  }
+}
+
+struct DumpChunk {
+  mrb_int begin = 0, end = 0;
+  std::optional<builder::string_builder> sb;
+  bool ok = false;
+};
+
+// Encodes a large Array as `threads` runs of elements in parallel and writes
+// them to the sink in order. Returns false without writing anything if the
+// array is too small or holds something the plain encoder cannot handle.
+static bool json_dump_array_threaded(mrb_state *mrb, mrb_value ary, size_t threads, DumpSink *sink) {
+  if (!mrb_array_p(ary)) return false;
+  const mrb_int len = RARRAY_LEN(ary);
+  const size_t n = std::min(threads, static_cast<size_t>(len));
+  if (n < 2) return false;
+  std::array<DumpChunk, THREADED_MAX_WORKERS> chunks;
+  for (size_t i = 0; i < n; ++i) {
+    chunks[i].begin = static_cast<mrb_int>(len * i / n);
+    chunks[i].end   = static_cast<mrb_int>(len * (i + 1) / n);
+  }
+  run_workers(n, [mrb, ary, &chunks](size_t i) {
+    DumpChunk &c = chunks[i];
+    auto &sb = c.sb.emplace();
+    c.ok = true;
+    for (mrb_int j = c.begin; c.ok && j < c.end; ++j) {
+      if (j > c.begin) sb.append_comma();
+      c.ok = json_encode_plain(mrb, mrb_ary_ref(mrb, ary, j), sb);
+    }
+  });
+  bool ok = true;
+  for (size_t i = 0; i < n; ++i) ok = ok && chunks[i].ok;
+  if (!ok) {
+    for (size_t i = 0; i < n; ++i) chunks[i].sb.reset();
+    return false;
+  }
+  dump_sink_write(mrb, sink, "[");
+  for (size_t i = 0; i < n; ++i) {
+    if (i > 0) dump_sink_write(mrb, sink, ",");
+    std::string_view sv = chunks[i].sb->view();
+    dump_sink_write(mrb, sink, sv);
+    chunks[i].sb.reset();
+  }
+  dump_sink_write(mrb, sink, "]");
+  return true;
+}
+
+static DumpSink dump_sink_for_string(mrb_state *mrb, mrb_value buf) {
+  if (!mrb_string_p(buf))
+    mrb_raise(mrb, E_TYPE_ERROR, "into: must be a String");
+  mrb_str_modify(mrb, mrb_str_ptr(buf));
+  return DumpSink{buf, false};
+}
+
+// indent: takes a number of spaces or the string to repeat per level.
+// Returns whether any option asks for something other than compact output.
+static bool dump_style_from_kwargs(mrb_state *mrb, mrb_value indent, mrb_value ascii_only, mrb_value escape_slash, DumpStyle &style) {
+  if (mrb_integer_p(indent)) {
+    mrb_int n = mrb_integer(indent);
+    if (n < 0) mrb_raise(mrb, E_ARGUMENT_ERROR, "indent must not be negative");
+    indent = mrb_str_new(mrb, NULL, n);
+    std::memset(RSTRING_PTR(indent), ' ', n);
+  }
+  if (mrb_string_p(indent)) style.indent = std::string_view(RSTRING_PTR(indent), RSTRING_LEN(indent));
+  else if (kwarg_test(indent)) mrb_raise(mrb, E_TYPE_ERROR, "indent must be an Integer or String");
+  style.ascii_only = kwarg_test(ascii_only);
+  style.escape_slash = kwarg_test(escape_slash);
+  return !style.indent.empty() || style.ascii_only || style.escape_slash;
+}
+
+static mrb_value json_dump_styled(mrb_state *mrb, mrb_value obj, DumpSink *sink, DumpStyle &style) {
+  style.state = json_state(mrb);
+  style.state->plan_epoch++;
+  builder::string_builder sb;
+  json_encode_as(mrb, obj, sb, sink, style);
+  if (sink) {
+    dump_sink_flush(mrb, sb, sink);
+    return sink->target;
+  }
+  std::string_view sv = sb.view();
+  return mrb_str_new(mrb, sv.data(), sv.size());
+}
+
 static mrb_value mrb_json_dump_m(mrb_state *mrb, mrb_value self) {
-  mrb_value obj; mrb_get_args(mrb, "o", &obj);
-  return mrb_json_dump(mrb, obj);
+  mrb_value obj, io = mrb_nil_value();
+  mrb_value kw_values[5] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(into), MRB_SYM(threads), MRB_SYM(indent), MRB_SYM(ascii_only), MRB_SYM(escape_slash)};
+  mrb_kwargs kwargs = {5, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "o|o:", &obj, &io, &kwargs);
+  const bool has_into = !mrb_undef_p(kw_values[0]) && !mrb_nil_p(kw_values[0]);
+  const size_t threads = threads_from_kwarg(mrb, kw_values[1]);
+  DumpStyle style;
+  const bool styled = dump_style_from_kwargs(mrb, kw_values[2], kw_values[3], kw_values[4], style);
+  if (unlikely(styled && threads > 1))
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "threads: cannot be combined with indent:, ascii_only: or escape_slash:");
+  if (mrb_nil_p(io) && !has_into) {
+    if (styled) return json_dump_styled(mrb, obj, nullptr, style);
+    if (threads > 1 && mrb_array_p(obj)) {
+      DumpSink sink{mrb_str_new(mrb, NULL, 0), false};
+      if (json_dump_array_threaded(mrb, obj, threads, &sink)) return sink.target;
+    }
+    return mrb_json_dump(mrb, obj);
+  }
+
+  DumpSink sink;
+  if (mrb_nil_p(io)) {
+    sink = dump_sink_for_string(mrb, kw_values[0]);
+  } else {
+    if (has_into)
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "pass either an io or into:, not both");
+    if (!mrb_respond_to(mrb, io, MRB_SYM(write)))
+      mrb_raise(mrb, E_TYPE_ERROR, "io must respond to write");
+    sink = DumpSink{io, true};
+  }
+  if (styled) return json_dump_styled(mrb, obj, &sink, style);
+  if (threads > 1 && json_dump_array_threaded(mrb, obj, threads, &sink)) return sink.target;
+  builder::string_builder sb;
+  json_encode(mrb, obj, sb, &sink);
+  dump_sink_flush(mrb, sb, &sink);
+  return sink.target;
+}
+
+static mrb_value mrb_json_pretty_generate(mrb_state *mrb, mrb_value self) {
+  mrb_value obj;
+  mrb_value kw_values[3] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(indent), MRB_SYM(ascii_only), MRB_SYM(escape_slash)};
+  mrb_kwargs kwargs = {3, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "o:", &obj, &kwargs);
+  if (mrb_undef_p(kw_values[0])) kw_values[0] = mrb_convert_number(mrb, 2);
+  DumpStyle style;
+  dump_style_from_kwargs(mrb, kw_values[0], kw_values[1], kw_values[2], style);
+  return json_dump_styled(mrb, obj, nullptr, style);
+}
+
+// ============================================================================
+// Text-to-text helpers — JSON.minify, PaddedString#minify!, JSON.reformat.
+// None of them builds Ruby values. minify is simdjson's SIMD kernel and, like
+// it, does not validate; reformat validates first and then rewrites the text
+// in one pass, copying strings and scalars verbatim.
+// ============================================================================
+
+static mrb_value mrb_json_minify(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+  const size_t len = RSTRING_LEN(str);
+  mrb_value out = mrb_str_new(mrb, NULL, len);
+  size_t out_len = 0;
+  auto code = simdjson::minify(RSTRING_PTR(str), len, RSTRING_PTR(out), out_len);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  mrb_str_resize(mrb, out, static_cast<mrb_int>(out_len));
+  return out;
+}
+
+static mrb_value mrb_padded_string_bytesize(mrb_state *mrb, mrb_value self) {
+  return mrb_convert_number(mrb, mrb_cpp_get<padded_string>(mrb, self)->size());
+}
+
+// The minified bytes get a buffer of their own: views and documents made
+// earlier still point into the old one, so it is kept alive (ivar retired)
+// for as long as this PaddedString is.
+static mrb_value mrb_padded_string_minify_bang(mrb_state *mrb, mrb_value self) {
+  auto *ps = mrb_cpp_get<padded_string>(mrb, self);
+  padded_string scratch(ps->size());
+  size_t out_len = 0;
+  auto code = simdjson::minify(ps->data(), ps->size(), scratch.data(), out_len);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  if (out_len == ps->size()) return self;
+  mrb_value retired = mrb_iv_get(mrb, self, MRB_SYM(retired));
+  if (mrb_nil_p(retired)) {
+    retired = mrb_ary_new(mrb);
+    mrb_iv_set(mrb, self, MRB_SYM(retired), retired);
+  }
+  mrb_value old = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, json_state(mrb)->json_mod, MRB_SYM(PaddedString)), 0, NULL);
+  mrb_ary_push(mrb, retired, old);
+  padded_string minified(scratch.data(), out_len);
+  ps->swap(minified);
+  mrb_cpp_get<padded_string>(mrb, old)->swap(minified);
+  return self;
+}
+
+struct ReformatOut {
+  mrb_state *mrb;
+  mrb_value str;
+  size_t pos = 0;
+  size_t capa;
+
+  char *reserve(size_t n) {
+    if (unlikely(capa - pos < n)) {
+      capa = std::max(capa * 2, pos + n);
+      mrb_str_resize(mrb, str, static_cast<mrb_int>(capa));
+    }
+    return RSTRING_PTR(str) + pos;
+  }
+  void put(const char *p, size_t n) { std::memcpy(reserve(n), p, n); pos += n; }
+  void put(char c) { *reserve(1) = c; ++pos; }
+  void newline(std::string_view indent, size_t depth) {
+    char *p = reserve(1 + indent.size() * depth);
+    *p++ = '\n';
+    for (size_t i = 0; i < depth; ++i, p += indent.size()) std::memcpy(p, indent.data(), indent.size());
+    pos += 1 + indent.size() * depth;
+  }
+};
+
+static inline bool json_ws(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+// Layout matches JSON.pretty_generate: empty containers stay {} / [],
+// members go one per line, and ": " separates keys when indenting. The
+// validating parse leaves stage 1's structural indexes in the default
+// parser (also when a big integer stops stage 2 and OnDemand finishes the
+// check), so the rewrite walks those offsets: every operator is emitted from
+// its index, and a string or scalar is copied verbatim up to the next index
+// minus the whitespace in between.
+static mrb_value mrb_json_reformat(mrb_state *mrb, mrb_value self) {
+  mrb_value str;
+  mrb_value kw_values[1] = {mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(indent)};
+  mrb_kwargs kwargs = {1, 0, kw_names, kw_values, NULL};
+  mrb_get_args(mrb, "S:", &str, &kwargs);
+  if (mrb_undef_p(kw_values[0])) kw_values[0] = mrb_convert_number(mrb, 2);
+  DumpStyle style;
+  dump_style_from_kwargs(mrb, kw_values[0], mrb_undef_value(), mrb_undef_value(), style);
+  auto code = json_validate(mrb, str);
+  if (unlikely(code != SUCCESS)) raise_simdjson_error(mrb, code);
+  const dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, json_default_dom_parser(mrb, mrb_class_ptr(self)));
+  const uint32_t *idx = parser->implementation->structural_indexes.get();
+  const size_t n = parser->implementation->n_structural_indexes;
+  const std::string_view indent = style.indent;
+  const char *buf = RSTRING_PTR(str);
+  const size_t len = RSTRING_LEN(str);
+  ReformatOut out{mrb, mrb_str_new(mrb, NULL, len + len / 2 + 16), 0, len + len / 2 + 16};
+  const bool pretty = !indent.empty();
+  size_t depth = 0;
+  for (size_t k = 0; k < n; ++k) {
+    const size_t i = idx[k];
+    const char c = buf[i];
+    switch (c) {
+    case '{': case '[':
+      out.put(c);
+      if (k + 1 < n && (buf[idx[k + 1]] == '}' || buf[idx[k + 1]] == ']')) { out.put(buf[idx[++k]]); break; }
+      ++depth;
+      if (pretty) out.newline(indent, depth);
+      break;
+    case '}': case ']':
+      --depth;
+      if (pretty) out.newline(indent, depth);
+      out.put(c);
+      break;
+    case ',':
+      out.put(c);
+      if (pretty) out.newline(indent, depth);
+      break;
+    case ':':
+      if (pretty) out.put(": ", 2); else out.put(c);
+      break;
+    default: {
+      size_t end = k + 1 < n ? idx[k + 1] : len;
+      while (json_ws(buf[end - 1])) --end;
+      out.put(buf + i, end - i);
+    }
+    }
+  }
+  mrb_str_resize(mrb, out.str, static_cast<mrb_int>(out.pos));
+  return out.str;
 }
 
 #define DEFINE_MRB_TO_JSON(func_name, ENCODER_CALL)                       \
   static mrb_value func_name(mrb_state *mrb, mrb_value o) {               \
     builder::string_builder sb;                                           \
     ENCODER_CALL;                                                         \
-    if (unlikely(!sb.validate_unicode()))                                 \
-      mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");                 \
     std::string_view sv = sb.view();                                      \
     return mrb_str_new(mrb, sv.data(), sv.size());                        \
   }
 
-DEFINE_MRB_TO_JSON(mrb_string_to_json,  json_encode_string(o, sb))
+DEFINE_MRB_TO_JSON(mrb_string_to_json,  json_encode_string(mrb, o, sb))
 DEFINE_MRB_TO_JSON(mrb_array_to_json,   json_encode_array(mrb, o, sb))
 DEFINE_MRB_TO_JSON(mrb_hash_to_json,    json_encode_hash(mrb, o, sb))
 #ifndef MRB_NO_FLOAT
@@ -995,34 +4278,46 @@ DEFINE_MRB_TO_JSON(mrb_symbol_to_json,  json_encode_symbol(mrb, o, sb))
 
 static mrb_value mrb_json_load_m(mrb_state *mrb, mrb_value self) {
   mrb_value path_str, dom_parser = mrb_undef_value();
-  mrb_value kw_values[1] = {mrb_undef_value()};
-  mrb_sym kw_names[] = {MRB_SYM(symbolize_names)};
-  mrb_kwargs kwargs = {1, 0, kw_names, kw_values, NULL};
+  mrb_value kw_values[3] = {mrb_undef_value(), mrb_undef_value(), mrb_undef_value()};
+  mrb_sym kw_names[] = {MRB_SYM(symbolize_names), MRB_SYM(cache_keys), MRB_SYM(mmap)};
+  mrb_kwargs kwargs = {3, 0, kw_names, kw_values, NULL};
   mrb_get_args(mrb, "S|o:", &path_str, &dom_parser, &kwargs);
-  mrb_bool symbolize_names = FALSE;
-  if (!mrb_undef_p(kw_values[0])) symbolize_names = mrb_bool(kw_values[0]);
-  std::string_view path(RSTRING_PTR(path_str), RSTRING_LEN(path_str));
-  auto res = padded_string::load(path);
-  if (unlikely(res.error() != SUCCESS)) mrb_sys_fail(mrb, "failed to read file");
+  ConvertOptions opts;
+  std::optional<KeyCache> key_cache;
+  convert_options_from_kwargs(mrb, kw_values[0], kw_values[1], opts, key_cache);
   if (mrb_undef_p(dom_parser))
-    dom_parser = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, mrb_class_ptr(self), MRB_SYM(DomParser)), 0, NULL);
+    dom_parser = json_default_dom_parser(mrb, mrb_class_ptr(self));
   mrb_gc_protect(mrb, dom_parser);
   dom::parser *parser = mrb_cpp_get<dom::parser>(mrb, dom_parser);
-  auto result = parser->parse(res.value());
-  if (unlikely(result.error() != SUCCESS)) raise_simdjson_error(mrb, result.error());
-  return convert_element(mrb, result.value(), symbolize_names);
+  if (kwarg_test(kw_values[2])) {
+    mrb_value mapped_obj = mrb_obj_new(mrb, mrb_class_get_under_id(mrb, mrb_class_ptr(self), MRB_SYM(MappedString)), 1, &path_str);
+    mrb_gc_protect(mrb, mapped_obj);
+    auto *mapped = mrb_cpp_get<MappedFile>(mrb, mapped_obj);
+    JSON_STAT_ADD(mrb, bytes_parsed, mapped->size());
+    JSON_STAT_ADD(mrb, zero_copy_hits, 1);
+    return json_dom_parse_convert(mrb, parser, mapped->data(), mapped->size(), opts);
+  }
+  std::string_view path(RSTRING_PTR(path_str), RSTRING_LEN(path_str));
+  auto res = padded_string::load(path);
+  if (unlikely(res.error() != SUCCESS)) mrb_sys_fail(mrb, "failed to read file");
+  JSON_STAT_ADD(mrb, bytes_parsed, res.value().size());
+  return json_dom_parse_convert(mrb, parser, res.value().data(), res.value().size(), opts);
 }
 
 MRB_BEGIN_DECL
 MRB_API mrb_value mrb_json_dump(mrb_state *mrb, mrb_value obj) {
   builder::string_builder sb;
   json_encode(mrb, obj, sb);
-  if (likely(sb.validate_unicode())) {
-    std::string_view sv = sb.view();
-    return mrb_str_new(mrb, sv.data(), sv.size());
-  }
-  mrb_raise(mrb, E_JSON_UTF8_ERROR, "invalid utf-8");
-  return mrb_undef_value();
+  std::string_view sv = sb.view();
+  return mrb_str_new(mrb, sv.data(), sv.size());
+}
+
+MRB_API mrb_value mrb_json_dump_into(mrb_state *mrb, mrb_value obj, mrb_value buf) {
+  DumpSink sink = dump_sink_for_string(mrb, buf);
+  builder::string_builder sb;
+  json_encode(mrb, obj, sb, &sink);
+  dump_sink_flush(mrb, sb, &sink);
+  return buf;
 }
 
 void mrb_mruby_fast_json_gem_init(mrb_state *mrb) {
@@ -1038,33 +4333,67 @@ void mrb_mruby_fast_json_gem_init(mrb_state *mrb) {
   auto impl = simdjson::get_active_implementation()->description();
   mrb_define_const_id(mrb, json_mod, MRB_SYM(SIMD_IMPLEMENTATION), mrb_str_new(mrb, impl.data(), impl.size()));
 
+  struct RClass *state_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(State), mrb->object_class);
+  MRB_SET_INSTANCE_TT(state_cls, MRB_TT_CDATA);
+  mrb_undef_class_method_id(mrb, state_cls, MRB_SYM(new));
+  mrb_value state_obj = mrb_obj_new(mrb, state_cls, 0, NULL);
+  mrb_iv_set(mrb, mrb_obj_value(mrb->object_class), MRB_SYM(fast_json_state), state_obj);
+  JsonState *state = mrb_cpp_new<JsonState>(mrb, state_obj);
+  state->json_mod = json_mod;
+
   struct RClass *json_error = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(ParserError), mrb->eStandardError_class);
+  state->errors[MRB_JSON_PARSER_ERROR] = json_error;
+
+#define DEFINE_JSON_ERROR(NAME, KIND) \
+  state->errors[MRB_JSON_##KIND##_ERROR] = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(NAME##Error), json_error)
+
+  DEFINE_JSON_ERROR(Tape, TAPE);                     DEFINE_JSON_ERROR(String, STRING);
+  DEFINE_JSON_ERROR(UnclosedString, UNCLOSED_STRING); DEFINE_JSON_ERROR(MemoryAllocation, MEMALLOC);
+  DEFINE_JSON_ERROR(Depth, DEPTH);                   DEFINE_JSON_ERROR(UTF8, UTF8);
+  DEFINE_JSON_ERROR(Number, NUMBER);                 DEFINE_JSON_ERROR(Capacity, CAPACITY);
+  DEFINE_JSON_ERROR(IncorrectType, INCORRECT_TYPE);  DEFINE_JSON_ERROR(EmptyInput, EMPTY_INPUT);
+  DEFINE_JSON_ERROR(TAtom, T_ATOM);                  DEFINE_JSON_ERROR(FAtom, F_ATOM);
+  DEFINE_JSON_ERROR(NAtom, N_ATOM);                  DEFINE_JSON_ERROR(BigInt, BIGINT);
+  DEFINE_JSON_ERROR(NumberOutOfRange, NUMBER_OUT_OF_RANGE); DEFINE_JSON_ERROR(UnescapedChars, UNESCAPED_CHARS);
+  DEFINE_JSON_ERROR(Uninitialized, UNINITIALIZED);   DEFINE_JSON_ERROR(ParserInUse, PARSER_IN_USE);
+  DEFINE_JSON_ERROR(ScalarDocumentAsValue, SCALAR_DOCUMENT_AS_VALUE);
+  DEFINE_JSON_ERROR(IncompleteArrayOrObject, INCOMPLETE_ARRAY_OR_OBJECT); DEFINE_JSON_ERROR(TrailingContent, TRAILING_CONTENT);
+  DEFINE_JSON_ERROR(OutOfCapacity, OUT_OF_CAPACITY); DEFINE_JSON_ERROR(InsufficientPadding, INSUFFICIENT_PADDING);
+  DEFINE_JSON_ERROR(IndexOutOfBounds, INDEX_OUT_OF_BOUNDS); DEFINE_JSON_ERROR(OutOfBounds, OUT_OF_BOUNDS);
+  DEFINE_JSON_ERROR(OutOfOrderIteration, OUT_OF_ORDER_ITERATION); DEFINE_JSON_ERROR(NoSuchField, NO_SUCH_FIELD);
+  DEFINE_JSON_ERROR(IO, IO);                         DEFINE_JSON_ERROR(InvalidJSONPointer, INVALID_JSON_POINTER);
+  DEFINE_JSON_ERROR(InvalidURIFragment, INVALID_URI_FRAGMENT); DEFINE_JSON_ERROR(UnsupportedArchitecture, UNSUPPORTED_ARCHITECTURE);
+  DEFINE_JSON_ERROR(Unexpected, UNEXPECTED);
+#undef DEFINE_JSON_ERROR
+
+  mrb_value errors = mrb_ary_new_capa(mrb, MRB_JSON_ERROR_COUNT);
+  for (struct RClass *err : state->errors) mrb_ary_push(mrb, errors, mrb_obj_value(err));
+  mrb_iv_set(mrb, state_obj, MRB_SYM(errors), errors);
 
-#define DEFINE_JSON_ERROR(NAME) mrb_define_class_under_id(mrb, json_mod, MRB_SYM(NAME##Error), json_error)
-
-  DEFINE_JSON_ERROR(Tape);           DEFINE_JSON_ERROR(String);
-  DEFINE_JSON_ERROR(UnclosedString); DEFINE_JSON_ERROR(MemoryAllocation);
-  DEFINE_JSON_ERROR(Depth);          DEFINE_JSON_ERROR(UTF8);
-  DEFINE_JSON_ERROR(Number);         DEFINE_JSON_ERROR(Capacity);
-  DEFINE_JSON_ERROR(IncorrectType);  DEFINE_JSON_ERROR(EmptyInput);
-  DEFINE_JSON_ERROR(TAtom);          DEFINE_JSON_ERROR(FAtom);
-  DEFINE_JSON_ERROR(NAtom);          DEFINE_JSON_ERROR(BigInt);
-  DEFINE_JSON_ERROR(NumberOutOfRange); DEFINE_JSON_ERROR(UnescapedChars);
-  DEFINE_JSON_ERROR(Uninitialized);  DEFINE_JSON_ERROR(ParserInUse);
-  DEFINE_JSON_ERROR(ScalarDocumentAsValue);
-  DEFINE_JSON_ERROR(IncompleteArrayOrObject); DEFINE_JSON_ERROR(TrailingContent);
-  DEFINE_JSON_ERROR(OutOfCapacity);  DEFINE_JSON_ERROR(InsufficientPadding);
-  DEFINE_JSON_ERROR(IndexOutOfBounds); DEFINE_JSON_ERROR(OutOfBounds);
-  DEFINE_JSON_ERROR(OutOfOrderIteration); DEFINE_JSON_ERROR(NoSuchField);
-  DEFINE_JSON_ERROR(IO);             DEFINE_JSON_ERROR(InvalidJSONPointer);
-  DEFINE_JSON_ERROR(InvalidURIFragment); DEFINE_JSON_ERROR(UnsupportedArchitecture);
-  DEFINE_JSON_ERROR(Unexpected);
-
-  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(parse),          mrb_json_parse_m,  MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(1,0));
-  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(dump),           mrb_json_dump_m,   MRB_ARGS_REQ(1));
-  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(parse_lazy),     mrb_json_parse_lazy, MRB_ARGS_ARG(1,1));
-  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(load_file_lazy), mrb_json_load_lazy, MRB_ARGS_ARG(1,1));
-  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(load_file),      mrb_json_load_m,   MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(1,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_Q(valid),        mrb_json_valid_p,       MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_B(validate),     mrb_json_validate_bang, MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(parse),          mrb_json_parse_m,  MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(6,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(dump),           mrb_json_dump_m,   MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(5,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(pretty_generate), mrb_json_pretty_generate, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(3,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(minify),          mrb_json_minify,          MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(reformat),        mrb_json_reformat,        MRB_ARGS_REQ(1)|MRB_ARGS_KEY(1,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(parse_lazy),     mrb_json_parse_lazy, MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(1,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(load_file_lazy), mrb_json_load_lazy, MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(2,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(load_file),      mrb_json_load_m,   MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(3,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(load_tape),      mrb_json_load_tape, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(4,0));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(zero_copy_parsing),   mrb_json_zero_copy_parsing,     MRB_ARGS_NONE());
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_E(zero_copy_parsing), mrb_json_set_zero_copy_parsing, MRB_ARGS_REQ(1));
+#ifdef MRB_JSON_STATS
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(stats),       mrb_json_stats,       MRB_ARGS_NONE());
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(reset_stats), mrb_json_reset_stats, MRB_ARGS_NONE());
+#endif
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(default_parser_capacity),   mrb_json_default_parser_capacity,     MRB_ARGS_NONE());
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(implementations),           mrb_json_implementations,             MRB_ARGS_NONE());
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(implementation),            mrb_json_implementation,              MRB_ARGS_NONE());
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_E(implementation),          mrb_json_set_implementation,          MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_Q(valid_utf8),              mrb_json_valid_utf8_p,                MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM_E(default_parser_capacity), mrb_json_set_default_parser_capacity, MRB_ARGS_REQ(1));
+  mrb_define_module_function_id(mrb, json_mod, MRB_SYM(parse_each),     mrb_json_parse_each, MRB_ARGS_ARG(1,1)|MRB_ARGS_KEY(3,0)|MRB_ARGS_BLOCK());
 
   mrb_define_method_id(mrb, mrb->object_class,  MRB_SYM(to_json), mrb_json_dump,       MRB_ARGS_NONE());
   mrb_define_method_id(mrb, mrb->string_class,  MRB_SYM(to_json), mrb_string_to_json,  MRB_ARGS_NONE());
@@ -1084,17 +4413,46 @@ void mrb_mruby_fast_json_gem_init(mrb_state *mrb) {
   mrb_define_method_id(mrb, dom_parser_cls, MRB_SYM(initialize), mrb_dom_parser_initialize, MRB_ARGS_OPT(1));
   mrb_define_method_id(mrb, dom_parser_cls, MRB_SYM(allocate),   mrb_dom_parser_allocate,   MRB_ARGS_OPT(1));
   mrb_define_method_id(mrb, dom_parser_cls, MRB_SYM(parse),      mrb_dom_parser_parse,      MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, dom_parser_cls, MRB_SYM(dump_tape),  mrb_dom_parser_dump_tape,  MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, dom_parser_cls, MRB_SYM(parse_many), mrb_dom_parser_parse_many, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(3,0));
+
+  struct RClass *dom_stream_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(DocumentStream), mrb->object_class);
+  MRB_SET_INSTANCE_TT(dom_stream_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, dom_stream_cls, MRB_SYM(each),            mrb_dom_document_stream_each,            MRB_ARGS_BLOCK());
+  mrb_define_method_id(mrb, dom_stream_cls, MRB_SYM(truncated_bytes), mrb_dom_document_stream_truncated_bytes, MRB_ARGS_NONE());
 
   struct RClass *ondemand_parser_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(OndemandParser), mrb->object_class);
   MRB_SET_INSTANCE_TT(ondemand_parser_cls, MRB_TT_CDATA);
   mrb_define_method_id(mrb, ondemand_parser_cls, MRB_SYM(initialize), mrb_ondemand_parser_initialize, MRB_ARGS_OPT(1));
   mrb_define_method_id(mrb, ondemand_parser_cls, MRB_SYM(allocate),   mrb_ondemand_parser_allocate,   MRB_ARGS_OPT(1));
   mrb_define_method_id(mrb, ondemand_parser_cls, MRB_SYM(iterate),    mrb_ondemand_parser_iterate,    MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, ondemand_parser_cls, MRB_SYM(iterate_many), mrb_ondemand_parser_iterate_many, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(2,0)|MRB_ARGS_BLOCK());
+
+  struct RClass *ondemand_stream_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(OndemandDocumentStream), mrb->object_class);
+  MRB_SET_INSTANCE_TT(ondemand_stream_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, ondemand_stream_cls, MRB_SYM(each),            mrb_ondemand_document_stream_each,            MRB_ARGS_BLOCK());
+  mrb_define_method_id(mrb, ondemand_stream_cls, MRB_SYM(truncated_bytes), mrb_ondemand_document_stream_truncated_bytes, MRB_ARGS_NONE());
+
+  struct RClass *stream_parser_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(StreamParser), mrb->object_class);
+  MRB_SET_INSTANCE_TT(stream_parser_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_SYM(initialize),     mrb_json_stream_parser_initialize,     MRB_ARGS_KEY(2,0)|MRB_ARGS_BLOCK());
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_SYM(feed),           mrb_json_stream_parser_feed,           MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_OPSYM(lshift),       mrb_json_stream_parser_push,           MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_SYM(finish),         mrb_json_stream_parser_finish,         MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_SYM(buffered_bytes), mrb_json_stream_parser_buffered_bytes, MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, stream_parser_cls, MRB_SYM(reset),          mrb_json_stream_parser_reset,          MRB_ARGS_NONE());
 
   struct RClass *ps_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(PaddedString), mrb->object_class);
   MRB_SET_INSTANCE_TT(ps_cls, MRB_TT_CDATA);
   mrb_define_method_id(mrb, ps_cls, MRB_SYM(initialize), mrb_padded_string_initialize, MRB_ARGS_REQ(1));
   mrb_define_class_method_id(mrb, ps_cls, MRB_SYM(load), mrb_padded_string_s_load, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, ps_cls, MRB_SYM(bytesize),  mrb_padded_string_bytesize,    MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, ps_cls, MRB_SYM_B(minify), mrb_padded_string_minify_bang, MRB_ARGS_NONE());
+
+  struct RClass *mapped_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(MappedString), mrb->object_class);
+  MRB_SET_INSTANCE_TT(mapped_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, mapped_cls, MRB_SYM(initialize), mrb_mapped_string_initialize, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, mapped_cls, MRB_SYM(bytesize),   mrb_mapped_string_bytesize,   MRB_ARGS_NONE());
 
   struct RClass *psv_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(PaddedStringView), mrb->object_class);
   MRB_SET_INSTANCE_TT(psv_cls, MRB_TT_CDATA);
@@ -1116,6 +4474,66 @@ void mrb_mruby_fast_json_gem_init(mrb_state *mrb) {
   mrb_define_method_id(mrb, doc_cls, MRB_SYM(array_each),           mrb_json_doc_array_each,            MRB_ARGS_BLOCK());
   mrb_define_method_id(mrb, doc_cls, MRB_SYM(object_each),          mrb_json_doc_object_each,           MRB_ARGS_BLOCK());
   mrb_define_method_id(mrb, doc_cls, MRB_SYM(into),                 mrb_document_deserialize,           MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(extract),              mrb_json_doc_extract,               MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(raw),                  mrb_json_doc_raw,                   MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(count_elements),       mrb_json_doc_count_elements,        MRB_ARGS_OPT(1));
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(count_fields),         mrb_json_doc_count_fields,          MRB_ARGS_OPT(1));
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(skip),                 mrb_json_doc_skip,                  MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM(close),                mrb_json_doc_close,                 MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, doc_cls, MRB_SYM_Q(closed),             mrb_json_doc_closed_p,              MRB_ARGS_NONE());
+
+  struct RClass *pool_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(ParserPool), mrb->object_class);
+  MRB_SET_INSTANCE_TT(pool_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(initialize), mrb_json_parser_pool_initialize, MRB_ARGS_KEY(2,0));
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(parse_lazy), mrb_json_parser_pool_parse_lazy, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(1,0));
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(checkout),   mrb_json_parser_pool_checkout,   MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(checkin),    mrb_json_parser_pool_checkin,    MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(available),  mrb_json_parser_pool_available,  MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(size),       mrb_json_parser_pool_size,       MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, pool_cls, MRB_SYM(dom_parser), mrb_json_parser_pool_dom_parser, MRB_ARGS_NONE());
+
+  struct RClass *conv_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(Converter), mrb->object_class);
+  MRB_SET_INSTANCE_TT(conv_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, conv_cls, MRB_SYM(initialize), mrb_json_converter_initialize, MRB_ARGS_REQ(1)|MRB_ARGS_KEY(4,0));
+  mrb_define_method_id(mrb, conv_cls, MRB_SYM(step),       mrb_json_converter_step,       MRB_ARGS_OPT(1));
+  mrb_define_method_id(mrb, conv_cls, MRB_SYM_Q(done),     mrb_json_converter_done_p,     MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, conv_cls, MRB_SYM(result),     mrb_json_converter_result,     MRB_ARGS_NONE());
+
+  struct RClass *lease_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(ParserLease), mrb->object_class);
+  MRB_SET_INSTANCE_TT(lease_cls, MRB_TT_CDATA);
+  mrb_undef_class_method_id(mrb, lease_cls, MRB_SYM(new));
+
+  struct RClass *raw_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(Raw), mrb->object_class);
+  state->raw_cls = raw_cls;
+  mrb_define_method_id(mrb, raw_cls, MRB_SYM(initialize), mrb_json_raw_initialize, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, raw_cls, MRB_SYM(to_s),       mrb_json_raw_to_s,       MRB_ARGS_NONE());
+
+  struct RClass *query_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(Query), mrb->object_class);
+  MRB_SET_INSTANCE_TT(query_cls, MRB_TT_CDATA);
+  mrb_define_method_id(mrb, query_cls, MRB_SYM(initialize), mrb_json_query_initialize, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, query_cls, MRB_SYM(paths),      mrb_json_query_paths,      MRB_ARGS_NONE());
+
+  struct RClass *tape_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(Tape), mrb->object_class);
+  MRB_SET_INSTANCE_TT(tape_cls, MRB_TT_CDATA);
+  mrb_undef_class_method_id(mrb, tape_cls, MRB_SYM(new));
+
+  struct RClass *element_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(Element), mrb->object_class);
+  MRB_SET_INSTANCE_TT(element_cls, MRB_TT_CDATA);
+  mrb_undef_class_method_id(mrb, element_cls, MRB_SYM(new));
+  state->element_cls = element_cls;
+  mrb_define_method_id(mrb, element_cls, MRB_OPSYM(aref),     mrb_json_element_aref,       MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(at_pointer), mrb_json_element_at_pointer, MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(size),       mrb_json_element_size,       MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(type),       mrb_json_element_type,       MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(each),       mrb_json_element_each,       MRB_ARGS_BLOCK());
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(keys),       mrb_json_element_keys,       MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, element_cls, MRB_SYM_Q(key),      mrb_json_element_has_key,    MRB_ARGS_REQ(1));
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(to_a),       mrb_json_element_to_a,       MRB_ARGS_NONE());
+  mrb_define_method_id(mrb, element_cls, MRB_SYM(to_h),       mrb_json_element_to_h,       MRB_ARGS_NONE());
+
+  struct RClass *into_plan_cls = mrb_define_class_under_id(mrb, json_mod, MRB_SYM(IntoPlan), mrb->object_class);
+  MRB_SET_INSTANCE_TT(into_plan_cls, MRB_TT_CDATA);
+  mrb_undef_class_method_id(mrb, into_plan_cls, MRB_SYM(new));
 
   // JSON::Type — Ruby class aliases so existing code using JSON::Type::String etc. still works,
   // and new code can use the Ruby classes directly (String, Integer, Array, Hash, etc.).
@@ -446,3 +446,1117 @@ assert("JSON.parse_lazy - native_ext_type Numeric accepts both int and float") d
   obj2 = doc2.into(WithNumeric.new)
   assert_true (obj2.n - 3.14).abs < 0.001
 end
+
+# ---------------------------------------------------------
+# Document streams — NDJSON / concatenated documents
+# ---------------------------------------------------------
+
+assert("JSON.parse_each - yields every NDJSON record") do
+  out = []
+  JSON.parse_each("{\"id\":1}\n{\"id\":2}\n[3]\n") { |obj| out << obj }
+  assert_equal [{"id"=>1}, {"id"=>2}, [3]], out
+end
+
+assert("JSON.parse_each - without block returns an array") do
+  assert_equal [1, "two", nil, true], JSON.parse_each('1 "two" null true')
+end
+
+assert("JSON.parse_each - symbolize_names") do
+  out = JSON.parse_each("{\"a\":1}\n{\"b\":2}", symbolize_names: true)
+  assert_equal [{a: 1}, {b: 2}], out
+end
+
+assert("JSON.parse_each - accepts a PaddedString") do
+  ps = JSON::PaddedString.new("{\"x\":1}\n{\"x\":2}")
+  assert_equal [{"x"=>1}, {"x"=>2}], JSON.parse_each(ps)
+end
+
+assert("JSON.parse_each - raises on malformed record") do
+  assert_raise JSON::ParserError do
+    JSON.parse_each("{\"a\":1}\n{\"a\":}\n")
+  end
+end
+
+assert("JSON.parse_each - rejects non positive batch_size") do
+  assert_raise ArgumentError do
+    JSON.parse_each("1", batch_size: 0)
+  end
+end
+
+assert("JSON::DomParser#parse_many - returns an enumerable stream") do
+  stream = JSON::DomParser.new.parse_many("{\"a\":1} {\"a\":2} {\"a\":3}")
+  assert_kind_of JSON::DocumentStream, stream
+  assert_equal [1, 2, 3], stream.map { |h| h["a"] }
+  assert_equal 0, stream.truncated_bytes
+end
+
+assert("JSON::OndemandParser#iterate_many - yields converted values") do
+  out = []
+  parser = JSON::OndemandParser.new
+  parser.iterate_many("{\"id\":1,\"tags\":[1,2]}\n{\"id\":2}\n\"str\"\n42\n", batch_size: 4096) { |v| out << v }
+  assert_equal [{"id"=>1, "tags"=>[1,2]}, {"id"=>2}, "str", 42], out
+end
+
+assert("JSON::OndemandParser#iterate_many - without block returns a stream") do
+  stream = JSON::OndemandParser.new.iterate_many("[1] [2]")
+  assert_kind_of JSON::OndemandDocumentStream, stream
+  assert_equal [[1], [2]], stream.each
+end
+
+# ---------------------------------------------------------
+# Shared default DomParser
+# ---------------------------------------------------------
+
+assert("JSON.default_parser_capacity= pre-sizes the shared parser") do
+  JSON.default_parser_capacity = 64 * 1024
+  assert_equal 64 * 1024, JSON.default_parser_capacity
+  assert_equal({"a"=>[1,2]}, JSON.parse('{"a":[1,2]}'))
+end
+
+assert("JSON.parse - shared parser grows for larger documents") do
+  JSON.default_parser_capacity = 64
+  big = "[" + (["1"] * 1000).join(",") + "]"
+  assert_equal 1000, JSON.parse(big).size
+  assert_true JSON.default_parser_capacity >= big.bytesize
+  assert_equal [1], JSON.parse("[1]")
+end
+
+assert("JSON.default_parser_capacity= rejects negative values") do
+  assert_raise ArgumentError do
+    JSON.default_parser_capacity = -1
+  end
+end
+
+# ---------------------------------------------------------
+# Key cache
+# ---------------------------------------------------------
+
+assert("JSON.parse - cache_keys shares frozen key strings") do
+  arr = JSON.parse('[{"id":1,"name":"a"},{"id":2,"name":"b"}]', cache_keys: true)
+  assert_equal [{"id"=>1, "name"=>"a"}, {"id"=>2, "name"=>"b"}], arr
+  k1 = arr[0].keys.first
+  k2 = arr[1].keys.first
+  assert_true k1.frozen?
+  assert_true k1.equal?(k2)
+end
+
+assert("JSON.parse - keys are frozen without cache_keys") do
+  h = JSON.parse('{"a":1}')
+  assert_true h.keys.first.frozen?
+end
+
+assert("JSON.parse - cache_keys with many distinct keys") do
+  keys = (0...1000).map { |i| "k#{i}" }
+  json = "{" + keys.map { |k| "\"#{k}\":1" }.join(",") + "}"
+  h = JSON.parse(json, cache_keys: true)
+  assert_equal keys, h.keys
+end
+
+assert("JSON.parse_lazy - cache_keys shares keys within one call") do
+  doc = JSON.parse_lazy('{"items":[{"sku":"a"},{"sku":"b"}]}', cache_keys: true)
+  items = doc["items"]
+  assert_equal [{"sku"=>"a"}, {"sku"=>"b"}], items
+  assert_true items[0].keys.first.equal?(items[1].keys.first)
+end
+
+assert("JSON.parse_each - cache_keys shares keys across records") do
+  recs = JSON.parse_each("{\"id\":1}\n{\"id\":2}", cache_keys: true)
+  assert_true recs[0].keys.first.equal?(recs[1].keys.first)
+end
+
+assert("JSON.parse_each - cache_keys holds a bounded number of keys") do
+  skip "needs ObjectSpace" unless Object.const_defined?(:ObjectSpace)
+  ndjson = (0...20_000).map { |i| "{\"key#{i}\":#{i}}" }.join("\n")
+  live = {}
+  JSON.parse_each(ndjson, cache_keys: true) do |rec|
+    i = rec.values.first
+    if i == 2_000 || i == 19_999
+      GC.start
+      live[i] = ObjectSpace.count_objects[:T_STRING]
+    end
+  end
+  # Evicted keys are collectable: 18k more distinct keys must not stay alive.
+  assert_true live[19_999] - live[2_000] < 1_000
+end
+
+# --- JSON.dump into a buffer / IO ---
+
+class DumpCollector
+  attr_reader :chunks
+  def initialize; @chunks = []; end
+  def write(str); @chunks << str; str.bytesize; end
+end
+
+assert("JSON.dump - into: appends to the given String") do
+  buf = "prefix:"
+  ret = JSON.dump({"a" => [1, 2]}, into: buf)
+  assert_true ret.equal?(buf)
+  assert_equal 'prefix:{"a":[1,2]}', buf
+end
+
+assert("JSON.dump - into: matches plain dump across chunk boundaries") do
+  obj = (0...20000).map { |i| {"id" => i, "name" => "item#{i}", "tags" => ["x", "y"]} }
+  buf = ""
+  JSON.dump(obj, into: buf)
+  assert_equal JSON.dump(obj), buf
+end
+
+assert("JSON.dump - io receives output in chunks") do
+  obj = (0...20000).map { |i| {"id" => i, "name" => "item#{i}"} }
+  io = DumpCollector.new
+  ret = JSON.dump(obj, io)
+  assert_true ret.equal?(io)
+  assert_true io.chunks.size > 1
+  assert_equal JSON.dump(obj), io.chunks.join
+end
+
+assert("JSON.dump - io and into: errors") do
+  assert_raise(TypeError) { JSON.dump([1], into: 42) }
+  assert_raise(TypeError) { JSON.dump([1], 42) }
+  assert_raise(ArgumentError) { JSON.dump([1], DumpCollector.new, into: "") }
+  assert_raise(FrozenError) { JSON.dump([1], into: "".freeze) }
+end
+
+# --- per-string UTF-8 validation on dump ---
+
+assert("JSON.dump - invalid UTF-8 in a nested value raises") do
+  assert_raise(JSON::UTF8Error) { JSON.dump({"ok" => [1, 2, "\xC0\xAF"]}) }
+end
+
+assert("JSON.dump - invalid UTF-8 in a key raises") do
+  assert_raise(JSON::UTF8Error) { JSON.dump({"\xFF" => 1}) }
+end
+
+assert("JSON.dump - invalid UTF-8 raises through into: and to_json") do
+  assert_raise(JSON::UTF8Error) { JSON.dump(["\xFF"], into: "") }
+  assert_raise(JSON::UTF8Error) { "\xFF".to_json }
+end
+
+assert("JSON.dump - valid multibyte strings pass") do
+  assert_equal "[\"hé\",\"日本\"]", JSON.dump(["hé", "日本"])
+end
+
+# --- threads: option ---
+
+def threaded_sample(n)
+  (0...n).map { |i| {"id" => i, "name" => "item#{i}", "vals" => [i, i * 0.5, nil, true], "pad" => "x" * 64} }
+end
+
+assert("JSON.parse - threads: matches serial parse on a large array") do
+  json = JSON.dump(threaded_sample(40000))
+  assert_true json.bytesize > 4 * 1024 * 1024
+  assert_equal JSON.parse(json), JSON.parse(json, threads: 4)
+  assert_equal JSON.parse(json, symbolize_names: true), JSON.parse(json, threads: 4, symbolize_names: true)
+end
+
+assert("JSON.parse - threads: falls back for small or non-array input") do
+  assert_equal [1, 2, 3], JSON.parse("[1,2,3]", threads: 8)
+  assert_equal({"a" => 1}, JSON.parse('{"a":1}', threads: 8))
+end
+
+assert("JSON.parse - threads: reports errors inside elements") do
+  json = JSON.dump(threaded_sample(40000))
+  bad = json.sub('"id":39000,', '"id":tru,')
+  assert_raise(JSON::ParserError) { JSON.parse(bad, threads: 4) }
+  assert_raise(JSON::ParserError) { JSON.parse(json[0, json.bytesize - 1], threads: 4) }
+end
+
+assert("JSON.parse - threads: splits inside strings and nesting correctly") do
+  tricky = (0...60000).map do |i|
+    {"s" => "a,\\\",[{b}]\\" * (i % 5), "n" => [[i, {"x" => [i, "],"]}]], "k" => {"," => "\\"}}
+  end
+  json = JSON.dump(tricky)
+  assert_true json.bytesize > 4 * 1024 * 1024
+  assert_equal JSON.parse(json), JSON.parse(json, threads: 8)
+  assert_equal JSON.parse(json), JSON.parse(" \n#{json}\n ", threads: 3)
+end
+
+assert("JSON.parse - threads: reuses its worker parsers across calls") do
+  small = JSON.dump(threaded_sample(20000))
+  big = JSON.dump(threaded_sample(50000))
+  first = JSON.parse(small, threads: 8)
+  assert_equal JSON.parse(big), JSON.parse(big, threads: 4)
+  assert_equal JSON.parse(small), JSON.parse(small, threads: 2)
+  assert_equal JSON.parse(small), first
+  active = JSON.implementation
+  other = JSON.implementations.find { |i| i != active } || active
+  begin
+    JSON.implementation = other
+    assert_equal JSON.parse(big), JSON.parse(big, threads: 8)
+  ensure
+    JSON.implementation = active
+  end
+end
+
+assert("JSON.parse - threads: empty elements are rejected") do
+  json = JSON.dump(threaded_sample(40000))
+  assert_raise(JSON::ParserError) { JSON.parse(json[0, json.bytesize - 1] + ",]", threads: 4) }
+  assert_raise(JSON::ParserError) { JSON.parse("[," + json[1, json.bytesize - 1], threads: 4) }
+end
+
+assert("JSON.dump - threads: matches serial dump") do
+  data = threaded_sample(10000)
+  assert_equal JSON.dump(data), JSON.dump(data, threads: 4)
+  buf = "x"
+  JSON.dump(data, into: buf, threads: 3)
+  assert_equal "x" + JSON.dump(data), buf
+  io = DumpCollector.new
+  JSON.dump(data, io, threads: 2)
+  assert_equal JSON.dump(data), io.chunks.join
+end
+
+assert("JSON.dump - threads: falls back for values the workers cannot encode") do
+  data = [{"a" => :sym}, {b: 1}, 2**70, Object.new.to_s]
+  assert_equal JSON.dump(data), JSON.dump(data, threads: 4)
+  assert_raise(JSON::UTF8Error) { JSON.dump(["ok", "\xFF"], threads: 2) }
+end
+
+assert("JSON.parse - threads: cannot be combined with shared_strings:") do
+  assert_raise(ArgumentError) { JSON.parse("[1]", threads: 2, shared_strings: true) }
+  assert_equal [1], JSON.parse("[1]", threads: 1, shared_strings: true)
+end
+
+assert("JSON.dump - threads: cannot be combined with style options") do
+  assert_raise(ArgumentError) { JSON.dump([1], threads: 2, indent: 2) }
+  assert_raise(ArgumentError) { JSON.dump([1], "".dup, threads: 2, ascii_only: true) }
+  assert_equal "[\n  1\n]", JSON.dump([1], threads: 1, indent: 2)
+end
+
+assert("JSON.parse / JSON.dump - threads: must be positive") do
+  assert_raise(ArgumentError) { JSON.parse("[1]", threads: 0) }
+  assert_raise(ArgumentError) { JSON.dump([1], threads: -1) }
+end
+
+# --- compiled into plans ---
+
+assert("Document#into - schema order differs from document order") do
+  class PlanOrder
+    attr_accessor :a, :b, :c
+    native_ext_type :@c, Integer
+    native_ext_type :@a, Integer
+    native_ext_type :@b, String
+  end
+
+  doc = JSON.parse_lazy('{"a":1,"skip":{"x":[1,2]},"b":"two","c":3}')
+  obj = doc.into(PlanOrder.new)
+  assert_equal [1, "two", 3], [obj.a, obj.b, obj.c]
+end
+
+assert("Document#into - plan is reused and picks up schema changes") do
+  class PlanGrow
+    attr_accessor :a, :b
+    native_ext_type :@a, Integer
+  end
+
+  objs = (0...50).map { |i| JSON.parse_lazy("{\"a\":#{i},\"b\":\"x\"}").into(PlanGrow.new) }
+  assert_equal (0...50).to_a, objs.map(&:a)
+  assert_nil objs.last.b
+
+  class PlanGrow
+    native_ext_type :@b, String
+  end
+  obj = JSON.parse_lazy('{"a":1,"b":"x"}').into(PlanGrow.new)
+  assert_equal "x", obj.b
+end
+
+assert("Document#into - first duplicate key wins") do
+  class PlanDup
+    attr_accessor :a
+    native_ext_type :@a, Integer
+  end
+
+  obj = JSON.parse_lazy('{"a":1,"a":"later"}').into(PlanDup.new)
+  assert_equal 1, obj.a
+end
+
+assert("Document#into - type mismatch is rejected before conversion") do
+  class PlanTyped
+    attr_accessor :n, :s
+    native_ext_type :@n, Integer
+    native_ext_type :@s, String
+  end
+
+  big = "{" + (0...2000).map { |i| "\"k#{i}\":[#{i}]" }.join(",") + "}"
+  assert_raise(TypeError) { JSON.parse_lazy("{\"n\":#{big}}").into(PlanTyped.new) }
+  assert_raise(TypeError) { JSON.parse_lazy('{"n":1.5}').into(PlanTyped.new) }
+  obj = JSON.parse_lazy('{"n":12345678901234567890123,"s":"ok"}').into(PlanTyped.new)
+  assert_equal "ok", obj.s
+  assert_true obj.n.kind_of?(Integer)
+end
+
+assert("Document#into - Object schema accepts any JSON value") do
+  class PlanAny
+    attr_accessor :v
+    native_ext_type :@v, Object
+  end
+
+  ['1', '1.5', '"s"', '[1]', '{"a":1}', 'true', 'false', 'null'].each do |json|
+    obj = JSON.parse_lazy("{\"v\":#{json}}").into(PlanAny.new)
+    assert_equal JSON.parse(json), obj.v
+  end
+end
+
+# --- nested into schemas ---
+
+class NestProduct
+  attr_accessor :sku, :price
+  native_ext_type :@sku,   String
+  native_ext_type :@price, Numeric
+end
+
+class NestLineItem
+  attr_accessor :qty, :product
+  native_ext_type :@qty,     Integer
+  native_ext_type :@product, NestProduct
+end
+
+class NestOrder
+  attr_accessor :id, :line_items, :tags
+  native_ext_type :@id,         Integer
+  native_ext_type :@line_items, [NestLineItem]
+  native_ext_type :@tags,       [String]
+end
+
+assert("Document#into - nested objects and typed arrays") do
+  json = '{"id":7,"tags":["a","b"],"line_items":[' \
+         '{"qty":2,"product":{"sku":"x1","price":9.5}},' \
+         '{"product":{"sku":"y2","price":3},"qty":1}]}'
+  order = JSON.parse_lazy(json).into(NestOrder.new)
+  assert_equal 7, order.id
+  assert_equal ["a", "b"], order.tags
+  assert_equal 2, order.line_items.size
+  assert_true order.line_items[0].kind_of?(NestLineItem)
+  assert_true order.line_items[1].product.kind_of?(NestProduct)
+  assert_equal "y2", order.line_items[1].product.sku
+  assert_equal 2, order.line_items[0].qty
+end
+
+assert("Document#into - nested type errors") do
+  assert_raise(TypeError) { JSON.parse_lazy('{"line_items":{"qty":1}}').into(NestOrder.new) }
+  assert_raise(TypeError) { JSON.parse_lazy('{"line_items":[1]}').into(NestOrder.new) }
+  assert_raise(TypeError) { JSON.parse_lazy('{"tags":["a",1]}').into(NestOrder.new) }
+  assert_raise(TypeError) { JSON.parse_lazy('{"line_items":[{"product":{"sku":5}}]}').into(NestOrder.new) }
+end
+
+class NestTree
+  attr_accessor :v, :child
+  native_ext_type :@v,     Integer
+  native_ext_type :@child, NestTree
+end
+
+assert("Document#into - self-nesting class keeps duplicate keys per level") do
+  json = '{"v":1,"child":{"v":2,"child":{"v":3,"v":"dup"},"v":"dup"},"v":"dup"}'
+  tree = JSON.parse_lazy(json).into(NestTree.new)
+  assert_equal 1, tree.v
+  assert_equal 2, tree.child.v
+  assert_equal 3, tree.child.child.v
+  assert_nil tree.child.child.child
+end
+
+class NestMorphChild
+  attr_accessor :v
+  native_ext_type :@v, Integer
+  def initialize
+    NestMorphParent.send(:native_ext_type, :"@x#{NestMorphParent.count += 1}", Integer)
+  end
+end
+
+class NestMorphParent
+  class << self; attr_accessor :count; end
+  self.count = 0
+  attr_accessor :a, :child, :z
+  native_ext_type :@a,     Integer
+  native_ext_type :@child, NestMorphChild
+  native_ext_type :@z,     String
+end
+
+assert("Document#into - schema redefined from a nested initialize") do
+  json = '{"child":{"v":1},"z":"ok","a":5,"x1":11,"x2":12}'
+  first = JSON.parse_lazy(json).into(NestMorphParent.new)
+  assert_equal [5, 1, "ok"], [first.a, first.child.v, first.z]
+  second = JSON.parse_lazy(json).into(NestMorphParent.new)
+  assert_equal 11, second.instance_variable_get(:@x1)
+  assert_equal 2, NestMorphParent.count
+end
+
+class NestSwapItem
+  attr_accessor :v
+  native_ext_type :@v, Integer
+  def initialize
+    NestSwapList.send(:native_ext_type, :@items, [Object])
+    GC.start
+  end
+end
+
+class NestSwapList
+  attr_accessor :items, :tail
+  native_ext_type :@items, [NestSwapItem]
+  native_ext_type :@tail,  String
+end
+
+assert("Document#into - schema types replaced while in use stay alive") do
+  list = JSON.parse_lazy('{"items":[{"v":1},{"v":2}],"tail":"t"}').into(NestSwapList.new)
+  assert_equal [1, 2], list.items.map(&:v)
+  assert_equal "t", list.tail
+  list = JSON.parse_lazy('{"items":[{"v":3}]}').into(NestSwapList.new)
+  assert_equal [{"v" => 3}], list.items
+end
+
+class NestLate
+  attr_accessor :n
+end
+
+class NestLateHolder
+  attr_accessor :late
+  native_ext_type :@late, NestLate
+end
+
+assert("Document#into - nested schema added after the plan was built") do
+  assert_raise(TypeError) { JSON.parse_lazy('{"late":{"n":1}}').into(NestLateHolder.new) }
+  class NestLate
+    native_ext_type :@n, Integer
+  end
+  holder = JSON.parse_lazy('{"late":{"n":1}}').into(NestLateHolder.new)
+  assert_true holder.late.kind_of?(NestLate)
+  assert_equal 1, holder.late.n
+end
+
+# --- mmap loading ---
+
+assert("JSON.load_file_lazy / load_file - mmap: true") do
+  File.open("tmp_mmap.json", "w") { |f| f.write('{"x":[1,2,3],"s":"hi"}') }
+  doc = JSON.load_file_lazy("tmp_mmap.json", mmap: true)
+  assert_equal [1, 2, 3], doc["x"]
+  assert_equal({"x" => [1, 2, 3], "s" => "hi"}, JSON.load_file("tmp_mmap.json", mmap: true))
+ensure
+  File.delete "tmp_mmap.json"
+end
+
+assert("JSON::MappedString - page-sized file keeps padding readable") do
+  body = '{"pad":"' + "x" * (4096 - 10) + '"}'
+  assert_equal 4096, body.bytesize
+  File.open("tmp_mmap_page.json", "w") { |f| f.write(body) }
+  mapped = JSON::MappedString.new("tmp_mmap_page.json")
+  assert_equal 4096, mapped.bytesize
+  doc = JSON::Document.new(JSON::PaddedStringView.new(mapped))
+  assert_equal 4086, doc["pad"].bytesize
+  assert_equal [{"pad" => "x" * 4086}], JSON::OndemandParser.new.iterate_many(mapped).to_a
+ensure
+  File.delete "tmp_mmap_page.json"
+end
+
+assert("JSON::MappedString - missing file raises") do
+  assert_raise(StandardError) { JSON::MappedString.new("does/not/exist.json") }
+  assert_raise(StandardError) { JSON.load_file("does/not/exist.json", mmap: true) }
+end
+
+# --- cached state ---
+
+assert("JSON.zero_copy_parsing - setter is honored by later parses") do
+  prev = JSON.zero_copy_parsing
+  JSON.zero_copy_parsing = true
+  assert_true JSON.zero_copy_parsing
+  assert_equal 1, JSON.parse_lazy('{"a":1}')["a"]
+  JSON.zero_copy_parsing = nil
+  assert_false JSON.zero_copy_parsing
+  assert_equal({"a" => 1}, JSON.parse('{"a":1}'))
+ensure
+  JSON.zero_copy_parsing = prev
+end
+
+assert("JSON errors - cached classes are the JSON constants") do
+  assert_raise(JSON::TapeError) { JSON.parse("true garbage") }
+  assert_raise(JSON::UTF8Error) { JSON.dump("\xff") }
+  assert_true JSON::TAtomError < JSON::ParserError
+  assert_raise(NoMethodError) { JSON::State.new }
+end
+
+# --- lazy elements ---
+
+assert("JSON.parse lazy: true - random access without conversion") do
+  root = JSON.parse('{"meta":{"count":3},"items":[{"sku":"a"},{"sku":"b"},{"sku":"c"}],"n":null}', lazy: true)
+  assert_kind_of JSON::Element, root
+  assert_equal :object, root.type
+  assert_equal 3, root["items"].size
+  assert_equal "c", root["items"][-1]["sku"]
+  assert_equal 3, root["meta"]["count"]
+  assert_equal 3, root[:meta][:count]
+  assert_nil root["n"]
+  assert_nil root["missing"]
+  assert_nil root["items"][10]
+  assert_equal "b", root.at_pointer("/items/1/sku")
+  assert_equal %w[meta items n], root.keys
+  assert_true root.key?("n")
+  assert_false root.key?("x")
+end
+
+assert("JSON.parse lazy: true - each, to_a, to_h") do
+  root = JSON.parse('{"a":[1,[2,3]],"b":{"c":true}}', lazy: true, symbolize_names: true)
+  seen = []
+  root.each { |k, v| seen << k }
+  assert_equal [:a, :b], seen
+  items = []
+  root[:a].each { |v| items << v }
+  assert_equal 1, items[0]
+  assert_kind_of JSON::Element, items[1]
+  assert_equal [1, [2, 3]], root[:a].to_a
+  assert_equal({c: true}, root[:b].to_h)
+  assert_equal [1, [2, 3]], root[:a].map { |v| v.is_a?(JSON::Element) ? v.to_a : v }
+  assert_raise(TypeError) { root.to_a }
+end
+
+assert("JSON.parse lazy: true - survives later parses and scalar roots") do
+  root = JSON.parse('[{"x":1}]', lazy: true)
+  JSON.parse('[{"y":2},{"z":3}]')
+  JSON.parse('{"other":"doc"}', lazy: true)
+  assert_equal 1, root[0]["x"]
+  assert_equal 42, JSON.parse("42", lazy: true)
+  assert_raise(NoMethodError) { JSON::Element.new }
+end
+
+assert("JSON.parse lazy: true - rejects options it cannot honor") do
+  assert_raise(ArgumentError) { JSON.parse('[1]', lazy: true, cache_keys: true) }
+  assert_raise(ArgumentError) { JSON.parse('[1]', lazy: true, threads: 2) }
+  assert_raise(ArgumentError) { JSON.parse('[1]', lazy: true, shared_strings: true) }
+  assert_raise(ArgumentError) { JSON.parse('[1]', lazy: true, bigint: :string) }
+  assert_equal 1, JSON.parse('[1]', lazy: true, cache_keys: false, threads: nil)[0]
+end
+
+# --- JSON::Query ---
+
+assert("Document#extract - pointers and paths in one pass") do
+  json = '{"user":{"id":7,"name":"A"},"items":[{"sku":"a-1"},{"sku":"b-2"}],"meta":{"region":"eu"},"x~y":1,"a/b":2}'
+  q = JSON::Query.new(["/user/id", "$.items[*].sku", "$['meta'].region", "/missing", "/items/1/sku", "/x~0y", "/a~1b"])
+  assert_equal ["/user/id", "$.items[*].sku", "$['meta'].region", "/missing", "/items/1/sku", "/x~0y", "/a~1b"], q.paths
+  doc = JSON.parse_lazy(json)
+  assert_equal [7, ["a-1", "b-2"], "eu", nil, "b-2", 1, 2], doc.extract(q)
+  assert_equal [7, ["a-1", "b-2"], "eu", nil, "b-2", 1, 2], doc.extract(q)
+  assert_equal "A", doc["user"]["name"]
+end
+
+assert("Document#extract - overlapping paths and whole values") do
+  doc = JSON.parse_lazy('{"a":{"b":[1,2,3],"c":true},"d":[[1],[2]]}')
+  res = doc.extract(["/a", "/a/b/2", "$.a.*", "$.d[*][0]", ""])
+  assert_equal({"b" => [1, 2, 3], "c" => true}, res[0])
+  assert_equal 3, res[1]
+  assert_equal [[1, 2, 3], true], res[2]
+  assert_equal [1, 2], res[3]
+  assert_equal({"a" => {"b" => [1, 2, 3], "c" => true}, "d" => [[1], [2]]}, res[4])
+end
+
+assert("JSON::Query - malformed paths raise") do
+  assert_raise(JSON::InvalidJSONPointerError) { JSON::Query.new(["user"]) }
+  assert_raise(JSON::InvalidJSONPointerError) { JSON::Query.new(["/a~2"]) }
+  assert_raise(JSON::InvalidJSONPointerError) { JSON::Query.new(["$.a[x]"]) }
+  assert_raise(TypeError) { JSON::Query.new([1]) }
+end
+
+# --- raw passthrough ---
+
+assert("Document#raw - verbatim sub-documents") do
+  json = '{"id":1,"payload":{"a":[1, 2],"b":"é"},"n":12 ,"s":"x"}'
+  doc = JSON.parse_lazy(json)
+  payload = doc.raw("/payload")
+  assert_equal '{"a":[1, 2],"b":"é"}', payload
+  assert_true payload.frozen?
+  assert_equal "12", doc.raw("/n")
+  assert_equal '"x"', doc.raw("/s")
+  assert_nil doc.raw("/missing")
+  assert_equal json, doc.raw("")
+end
+
+assert("JSON::Raw - emitted byte for byte") do
+  raw = JSON::Raw.new('{"a":[1, 2]}')
+  assert_equal '{"a":[1, 2]}', raw.to_s
+  assert_equal '{"x":{"a":[1, 2]},"y":[{"a":[1, 2]}]}', JSON.dump({"x" => raw, "y" => [raw]})
+  assert_equal '{"a":[1, 2]}', raw.to_json
+  buf = ""
+  JSON.dump([raw, 1], into: buf)
+  assert_equal '[{"a":[1, 2]},1]', buf
+  assert_equal '[{"a":[1, 2]},{"a":[1, 2]}]', JSON.dump([raw, raw], threads: 2)
+end
+
+class RawNoSuper < JSON::Raw
+  def initialize(text); @text = text; end
+end
+
+class RawWithSuper < JSON::Raw
+  def initialize(n); super("[#{n}]"); end
+end
+
+assert("JSON::Raw - subclasses") do
+  assert_equal '{"r":[3]}', JSON.dump({"r" => RawWithSuper.new(3)})
+  assert_raise(TypeError) { JSON.dump([RawNoSuper.new("1")]) }
+  assert_raise(TypeError) { JSON.dump(RawNoSuper.new("1"), indent: 2) }
+  assert_raise(TypeError) { JSON.dump([RawNoSuper.new("1")], threads: 2) }
+end
+
+# --- JSON::StreamParser ---
+
+assert("JSON::StreamParser - values across chunk boundaries") do
+  sp = JSON::StreamParser.new
+  assert_equal [{"id" => 1}], sp.feed('{"id":1}{"id"')
+  assert_equal 5, sp.buffered_bytes
+  assert_equal [{"id" => 2}, 7], sp.feed(':2} 7 ')
+  assert_equal [], sp.feed('"a\\"')
+  assert_equal ["a\"b", [1, "]"]], sp.feed('b"[1,"]"]tr')
+  assert_equal [], sp.feed('ue')
+  assert_equal [true], sp.finish
+  assert_equal 0, sp.buffered_bytes
+end
+
+assert("JSON::StreamParser - block, symbolize_names and NDJSON") do
+  seen = []
+  sp = JSON::StreamParser.new(symbolize_names: true) { |v| seen << v }
+  ndjson = (1..50).map { |i| JSON.dump({"n" => i}) }.join("\n") + "\n"
+  pos = 0
+  while pos < ndjson.bytesize
+    sp << ndjson[pos, 7]
+    pos += 7
+  end
+  sp.finish
+  assert_equal 50, seen.size
+  assert_equal({n: 50}, seen.last)
+end
+
+assert("JSON::StreamParser - errors drop only the bad value") do
+  seen = []
+  sp = JSON::StreamParser.new { |v| seen << v }
+  assert_raise(JSON::ParserError) { sp << '[1] [1,] [2]' }
+  assert_equal [[1]], seen
+  sp << "\n"
+  assert_equal [[1], [2]], seen
+  sp << '{"open":'
+  assert_raise(JSON::IncompleteArrayOrObjectError) { sp.finish }
+  assert_equal 0, sp.buffered_bytes
+end
+
+assert("JSON::StreamParser - << needs a block") do
+  sp = JSON::StreamParser.new
+  assert_raise(ArgumentError) { sp << '[1] ' }
+  assert_equal 0, sp.buffered_bytes
+  assert_equal [[1]], sp.feed('[1] ')
+end
+
+assert("JSON::StreamParser - scanning resumes after a bad value mid-chunk") do
+  sp = JSON::StreamParser.new
+  sp.feed('[1')
+  assert_raise(JSON::ParserError) { sp.feed('] [1,] [2') }
+  assert_equal 3, sp.buffered_bytes
+  assert_equal [[2], 3], sp.feed('] 3 ')
+  assert_equal 0, sp.buffered_bytes
+end
+
+# --- pretty output / escaping options ---
+
+assert("JSON.pretty_generate - indented layout") do
+  obj = {"a" => [1, {"b" => nil}], "e" => {}, "f" => []}
+  expected = "{\n  \"a\": [\n    1,\n    {\n      \"b\": null\n    }\n  ],\n  \"e\": {},\n  \"f\": []\n}"
+  assert_equal expected, JSON.pretty_generate(obj)
+  assert_equal expected, JSON.dump(obj, indent: 2)
+  assert_equal "[\n\t1\n]", JSON.dump([1], indent: "\t")
+  assert_equal obj, JSON.parse(JSON.pretty_generate(obj, indent: 3))
+  assert_equal '{"a":1}', JSON.dump({"a" => 1}, indent: 0)
+end
+
+assert("JSON.dump - ascii_only and escape_slash") do
+  assert_equal '"\u00e9/\ud83d\ude00"', JSON.dump("é/😀", ascii_only: true)
+  assert_equal '"<\/script>"', JSON.dump("</script>", escape_slash: true)
+  long = "abcdefghij" * 3 + "é" + "\n\"\\" + "/"
+  assert_equal '"' + "abcdefghij" * 3 + '\u00e9\n\"\\\\\/"', JSON.dump(long, ascii_only: true, escape_slash: true)
+  assert_equal long, JSON.parse(JSON.dump([long], ascii_only: true, escape_slash: true))[0]
+  assert_equal '{"k\u00e9":[1]}', JSON.dump({"ké" => [1]}, ascii_only: true)
+  buf = ""
+  JSON.dump({"a" => "é"}, into: buf, indent: 1, ascii_only: true)
+  assert_equal "{\n \"a\": \"\\u00e9\"\n}", buf
+  assert_raise(JSON::UTF8Error) { JSON.dump("\xff", ascii_only: true) }
+  assert_raise(ArgumentError) { JSON.dump(1, indent: -1) }
+end
+
+# --- custom object serialization ---
+
+class DumpAsJson
+  def initialize(v); @v = v; end
+  def as_json; {"v" => @v}; end
+end
+
+class DumpToJson
+  def to_json; '{"raw":true}'; end
+end
+
+class DumpBadToJson
+  def to_json; "\"\xFF\""; end
+end
+
+class DumpSchema
+  native_ext_type :@name, String
+  native_ext_type :@tags, [String]
+  def initialize(name, tags); @name, @tags = name, tags; end
+end
+
+class DumpPlain
+  def to_s; "plain"; end
+end
+
+assert("JSON.dump - as_json, to_json, schema and to_s objects") do
+  assert_equal '[{"v":1},{"v":[2]}]', JSON.dump([DumpAsJson.new(1), DumpAsJson.new([2])])
+  assert_equal '{"a":{"raw":true}}', JSON.dump({"a" => DumpToJson.new})
+  assert_equal '{"name":"n","tags":["x"]}', JSON.dump(DumpSchema.new("n", ["x"]))
+  assert_equal "{\n  \"name\": \"n\",\n  \"tags\": []\n}", JSON.pretty_generate(DumpSchema.new("n", []))
+  assert_equal '["plain","plain"]', JSON.dump([DumpPlain.new, DumpPlain.new])
+  assert_raise(JSON::UTF8Error) { JSON.dump([DumpBadToJson.new]) }
+  assert_raise(JSON::UTF8Error) { JSON.pretty_generate({"a" => DumpBadToJson.new}) }
+  assert_raise(JSON::UTF8Error) { JSON.dump([DumpBadToJson.new], into: "") }
+end
+
+assert("JSON.dump - methods defined after a dump are picked up by the next one") do
+  class DumpLateHook
+    def to_s; "late"; end
+  end
+  assert_equal '["late"]', JSON.dump([DumpLateHook.new])
+  class DumpLateHook
+    def as_json; {"hook" => "as_json"}; end
+  end
+  assert_equal '[{"hook":"as_json"}]', JSON.dump([DumpLateHook.new])
+  assert_equal '{"hook":"as_json"}', DumpLateHook.new.as_json.to_json
+  class DumpLateHook
+    undef_method :as_json
+    native_ext_type :@n, Integer
+    def initialize; @n = 1; end
+  end
+  assert_equal '{"n":1}', JSON.dump(DumpLateHook.new)
+  assert_equal "[\n  {\n    \"n\": 1\n  }\n]", JSON.pretty_generate([DumpLateHook.new])
+end
+
+# --- pre-sized containers ---
+
+assert("JSON.parse - large and nested containers keep every element") do
+  big = (0...5000).map { |i| i.even? ? {"i" => i, "a" => [i, [i]]} : "s#{i}" }
+  json = JSON.dump(big)
+  assert_equal big, JSON.parse(json)
+  doc = JSON.parse_lazy(JSON.dump({"big" => big, "o" => {"x" => [], "y" => {}}}))
+  assert_equal big, doc["big"]
+  assert_equal({"x" => [], "y" => {}}, doc["o"])
+end
+
+# --- parse statistics (only in MRB_JSON_STATS builds) ---
+
+if JSON.respond_to?(:stats)
+  assert("JSON.stats - counts documents, strings, keys and errors") do
+    JSON.reset_stats
+    JSON.parse('{"a":"x","b":["y"]}')
+    assert_raise(JSON::TapeError) { JSON.parse('true garbage') }
+    s = JSON.stats
+    assert_equal 1, s[:documents]
+    assert_equal 2, s[:strings]
+    assert_equal 2, s[:keys]
+    assert_equal 1, s[:errors][JSON::TapeError]
+    assert_true s[:bytes_parsed] >= 19
+    JSON.reset_stats
+    assert_equal 0, JSON.stats[:documents]
+    assert_equal({}, JSON.stats[:errors])
+  end
+end
+
+# --- shared strings ---
+
+assert("JSON.parse - shared_strings") do
+  blob = "x" * 200
+  expected = {"blob" => blob, "esc" => "a\nb", "list" => ["short", blob], "n" => 1,
+              "k\"ey" => {"a\nb" => blob}}
+  json = JSON.dump(expected)
+  assert_equal expected, JSON.parse(json)
+  prev = JSON.zero_copy_parsing
+  begin
+    JSON.zero_copy_parsing = true
+    assert_equal expected, JSON.parse(json, shared_strings: true)
+    assert_equal expected, JSON.parse(json.dup, shared_strings: true, symbolize_names: false)
+    assert_equal "s", JSON.parse('"s"', shared_strings: true)
+    assert_raise(JSON::ParserError) { JSON.parse('{"a":"b"} x' + " " * 64, shared_strings: true) }
+  ensure
+    JSON.zero_copy_parsing = prev
+  end
+  assert_equal expected, JSON.parse(json, shared_strings: true)
+end
+
+# --- big integers ---
+
+assert("JSON.parse - integers beyond 64 bits on the DOM path") do
+  digits = "123456789012345678901234567890123456789"
+  obj = JSON.parse('{"id":' + digits + ',"neg":-' + digits + ',"n":[1, ' + digits + ' ]}')
+  assert_equal digits.to_i, obj["id"]
+  assert_equal(-digits.to_i, obj["neg"])
+  assert_equal [1, digits.to_i], obj["n"]
+  assert_equal digits.to_i, JSON.parse(digits)
+  assert_equal digits.to_i, JSON::DomParser.new.parse("[#{digits}]")[0]
+end
+
+assert("JSON.parse - escaped keys next to integers beyond 64 bits") do
+  digits = "123456789012345678901234567890"
+  json = '{"caf\\u00e9":1,"a\\nb":{"k\\"ey":2},"n":' + digits + '}'
+  expected = {"café" => 1, "a\nb" => {"k\"ey" => 2}, "n" => digits.to_i}
+  assert_equal expected, JSON.parse(json)
+  assert_equal expected, JSON.parse(json, cache_keys: true)
+  assert_equal expected, JSON::DomParser.new.parse(json)
+  assert_equal [:café, :"a\nb"], JSON.parse(json, symbolize_names: true).keys[0, 2]
+  File.open("tmp_bigint_keys.json", "w") { |f| f.write(json) }
+  assert_equal expected, JSON.load_file("tmp_bigint_keys.json")
+ensure
+  File.delete "tmp_bigint_keys.json"
+end
+
+assert("JSON.parse - bigint: :string and :raw") do
+  digits = "98765432109876543210987654321"
+  assert_equal({"a" => digits, "b" => 1}, JSON.parse('{"a":' + digits + ',"b":1}', bigint: :string))
+  assert_equal "18446744073709551615", JSON.parse("18446744073709551615", bigint: :string)
+  raw = JSON.parse("[#{digits}]", bigint: :raw)[0]
+  assert_kind_of JSON::Raw, raw
+  assert_equal "[#{digits}]", JSON.dump([raw])
+  assert_raise(ArgumentError) { JSON.parse("1", bigint: :float) }
+  assert_raise(JSON::BigIntError) { JSON.parse("9" * 5000, bigint: :string) }
+end
+
+# --- validation and counting ---
+
+assert("JSON.valid? / JSON.validate!") do
+  assert_true JSON.valid?('{"a":[1,2,{"b":null}]}')
+  assert_true JSON.valid?('[1, 123456789012345678901234567890, "x"]')
+  assert_false JSON.valid?('{"a":}')
+  assert_false JSON.valid?('[1, 123456789012345678901234567890, tru]')
+  assert_false JSON.valid?('[1] [2]')
+  assert_true JSON.validate!('"ok"')
+  assert_raise(JSON::TapeError) { JSON.validate!('true garbage') }
+  assert_raise(JSON::TAtomError) { JSON.validate!('[123456789012345678901234567890, tru]') }
+end
+
+assert("JSON.valid? / validate! / reformat leave the input String alone") do
+  prev = JSON.zero_copy_parsing
+  [false, true].each do |zero_copy|
+    JSON.zero_copy_parsing = zero_copy
+    body = '{"a":[1,2,3]}' * 1
+    whole = body + ("[" + "1," * 5000 + "1]")
+    json = whole[body.bytesize, whole.bytesize - body.bytesize]
+    [body, json, body.dup.freeze].each do |str|
+      frozen = str.frozen?
+      size = str.bytesize
+      assert_true JSON.valid?(str)
+      assert_true JSON.validate!(str)
+      JSON.reformat(str)
+      assert_equal frozen, str.frozen?
+      assert_equal size, str.bytesize
+      str << " " unless frozen
+    end
+  end
+ensure
+  JSON.zero_copy_parsing = prev
+end
+
+assert("Document#count_elements / count_fields / skip") do
+  doc = JSON.parse_lazy('{"items":[1,[2,3],{"x":4}],"meta":{"a":1,"b":2}}')
+  assert_equal 2, doc.count_fields
+  assert_equal 3, doc.count_elements("/items")
+  assert_equal 2, doc.count_fields("/meta")
+  assert_nil doc.count_elements("/missing")
+  assert_raise(TypeError) { doc.count_elements }
+  assert_equal doc, doc.skip
+  assert_equal 4, doc.at_pointer("/items/2/x")
+  assert_equal 0, JSON.parse_lazy("[]").count_elements
+  assert_raise(JSON::ParserError) { JSON.parse_lazy('[1,2] 3').skip }
+end
+
+# --- compiled dump plans ---
+
+class DumpPlanInner
+  native_ext_type :@score, Float
+  def initialize(score); @score = score; end
+end
+
+class DumpPlanRecord
+  native_ext_type :@id,    Integer
+  native_ext_type :@name,  String
+  native_ext_type :@inner, DumpPlanInner
+  def initialize(id, name, inner); @id, @name, @inner = id, name, inner; end
+end
+
+assert("JSON.dump - schema records use the compiled plan") do
+  recs = [DumpPlanRecord.new(1, "a\"b", DumpPlanInner.new(1.5)), DumpPlanRecord.new("x", nil, nil)]
+  expected = '[{"id":1,"name":"a\"b","inner":{"score":1.5}},{"id":"x","name":null,"inner":null}]'
+  assert_equal expected, JSON.dump(recs)
+  assert_equal JSON.parse(expected), JSON.parse(JSON.pretty_generate(recs))
+  assert_raise(JSON::UTF8Error) { JSON.dump(DumpPlanRecord.new(1, "\xff", nil)) }
+end
+
+assert("JSON.dump / Document#into - a replaced schema entry is seen by the next call") do
+  class DumpPlanSwap
+    attr_accessor :n
+    native_ext_type :@n, Integer
+  end
+  recs = (0...3).map { |i| o = DumpPlanSwap.new; o.n = i; o }
+  assert_equal '[{"n":0},{"n":1},{"n":2}]', JSON.dump(recs)
+  assert_raise(TypeError) { JSON.parse_lazy('{"n":"s"}').into(DumpPlanSwap.new) }
+  class DumpPlanSwap
+    native_ext_type :@n, String
+  end
+  assert_equal "s", JSON.parse_lazy('{"n":"s"}').into(DumpPlanSwap.new).n
+  assert_equal '[{"n":0},{"n":1},{"n":2}]', JSON.dump(recs)
+end
+
+assert("JSON.dump - Symbol and String keys") do
+  data = JSON.parse('{"a":1,"b\"c":{"d":[true]}}', symbolize_names: true)
+  2.times { assert_equal '{"a":1,"b\"c":{"d":[true]}}', JSON.dump(data) }
+  assert_equal '{"\u00e9":1}', JSON.dump({:"é" => 1}, ascii_only: true)
+  assert_equal "{\n  \"a\": 1\n}", JSON.pretty_generate({a: 1})
+  assert_equal '{"1":2,"x":3}', JSON.dump({1 => 2, "x" => 3})
+end
+
+assert("JSON::ParserPool") do
+  pool = JSON::ParserPool.new(size: 2, capacity: 4096)
+  assert_equal 2, pool.size
+  a = pool.parse_lazy('{"a":1}')
+  b = pool.parse_lazy('[1,2]')
+  assert_equal 0, pool.available
+  assert_raise(JSON::ParserInUseError) { pool.parse_lazy('{}') }
+  assert_equal 1, a["a"]
+  a.close
+  assert_true a.closed?
+  assert_raise(JSON::UninitializedError) { a["a"] }
+  assert_equal 1, pool.available
+  assert_equal 2, pool.with_document('{"x":2}') { |d| d["x"] }
+  assert_equal 1, pool.available
+  assert_raise(JSON::EmptyInputError) { pool.parse_lazy('') }
+  assert_equal 1, pool.available
+  parser = pool.checkout
+  assert_kind_of JSON::OndemandParser, parser
+  assert_equal 0, pool.available
+  pool.checkin(parser)
+  pool.checkin(b)
+  assert_equal 2, pool.available
+  assert_equal({"k" => [1]}, pool.parse('{"k":[1]}'))
+end
+
+assert("JSON::Converter") do
+  json = JSON.dump({"a" => (1..1000).map { |i| {"i" => i, "s" => [i.to_s]} }, "b" => {}, "c" => []})
+  conv = JSON::Converter.new(json)
+  assert_false conv.done?
+  assert_raise(RuntimeError) { conv.result }
+  steps = 0
+  steps += 1 until conv.step(0)
+  assert_true steps > 1
+  assert_equal JSON.parse(json), conv.result
+  assert_equal [1, {a: [nil]}], JSON::Converter.new('[1,{"a":[null]}]', symbolize_names: true).tap(&:step).result
+  assert_equal 42, JSON::Converter.new("42").result
+  deep = "[" * 2000 + "]" * 2000
+  assert_raise(JSON::DepthError) { JSON::Converter.new(deep) }
+  conv = JSON::Converter.new(deep, max_depth: 4000)
+  conv.step
+  v = conv.result
+  1999.times { v = v[0] }
+  assert_equal [], v
+  assert_raise(JSON::ParserError) { JSON::Converter.new('[1,') }
+end
+
+assert("JSON::Converter - integers beyond 64 bits") do
+  json = '{"big":[123456789012345678901234567890,-18446744073709551617],"n":1}'
+  conv = JSON::Converter.new(json)
+  assert_true conv.done?
+  assert_true conv.step
+  assert_equal JSON.parse(json), conv.result
+  assert_equal({big: ["123456789012345678901234567890", "-18446744073709551617"], n: 1},
+               JSON::Converter.new(json, symbolize_names: true, bigint: :string).result)
+  assert_equal ["18446744073709551615"], JSON::Converter.new("[18446744073709551615]", bigint: :string).tap(&:step).result
+  assert_raise(ArgumentError) { JSON::Converter.new("[]", bigint: :nope) }
+  escaped = '{"caf\\u00e9":{"k\\"ey":123456789012345678901234567890}}'
+  assert_equal({"café" => {"k\"ey" => 123456789012345678901234567890}}, JSON::Converter.new(escaped).result)
+  assert_equal [:café], JSON::Converter.new(escaped, symbolize_names: true, cache_keys: true).result.keys
+end
+
+assert("DomParser#dump_tape / JSON.load_tape") do
+  json = '{"name":"café","ids":[1,-2,18446744073709551615,1.5],"flags":[true,false,null],"empty":{},"s":""}'
+  parser = JSON::DomParser.new
+  assert_raise(JSON::UninitializedError) { parser.dump_tape("tmp.tape") }
+  expected = parser.parse(json)
+  assert_equal parser, parser.dump_tape("tmp.tape")
+  assert_equal expected, JSON.load_tape("tmp.tape")
+  assert_equal "café", JSON.load_tape("tmp.tape", symbolize_names: true)[:name]
+  lazy = JSON.load_tape("tmp.tape", lazy: true)
+  assert_kind_of JSON::Element, lazy
+  assert_equal 1.5, lazy.at_pointer("/ids/3")
+  assert_raise(JSON::ParserError) { parser.parse("[1,") }
+  assert_raise(JSON::UninitializedError) { parser.dump_tape("tmp.tape") }
+  File.open("tmp.tape", "w") { |f| f.write(json) }
+  assert_raise(JSON::TapeError) { JSON.load_tape("tmp.tape") }
+  File.delete "tmp.tape"
+end
+
+assert("DomParser#dump_tape - refuses the tape a failed parse_many left behind") do
+  parser = JSON::DomParser.new
+  parser.parse('{"earlier":[1,2,3,4,5,6,7,8]}')
+  seen = []
+  assert_raise(JSON::ParserError) { parser.parse_many('[1] [1,] [2]').each { |v| seen << v } }
+  assert_equal [[1]], seen
+  assert_raise(JSON::UninitializedError) { parser.dump_tape("tmp_stream.tape") }
+  parser.parse('{"earlier":[1]}')
+  assert_raise(JSON::ParserError) { JSON.parse_each('[1] {"a":}', parser) { } }
+  assert_raise(JSON::UninitializedError) { parser.dump_tape("tmp_stream.tape") }
+end
+
+assert("JSON.load_tape - rejects tapes nested deeper than max_depth") do
+  deep = "[" * 1500 + "]" * 1500
+  parser = JSON::DomParser.new
+  parser.allocate(deep.bytesize, 2000)
+  parser.parse(deep)
+  parser.dump_tape("tmp_deep.tape")
+  assert_raise(JSON::TapeError) { JSON.load_tape("tmp_deep.tape") }
+  v = JSON.load_tape("tmp_deep.tape", max_depth: 1500)
+  1499.times { v = v[0] }
+  assert_equal [], v
+  assert_raise(JSON::TapeError) { JSON.load_tape("tmp_deep.tape", max_depth: 1499) }
+  File.delete "tmp_deep.tape"
+end
+
+assert("JSON.minify / JSON.reformat / PaddedString#minify!") do
+  pretty = "{\n  \"a\" : [ 1, 2.5, \"x \\\" y\" ],\n\t\"b\": { },\r\n \"c\":[]}"
+  assert_equal '{"a":[1,2.5,"x \" y"],"b":{},"c":[]}', JSON.minify(pretty)
+  assert_equal "", JSON.minify("")
+  assert_raise(JSON::UnclosedStringError) { JSON.minify('{"a') }
+  obj = JSON.parse(pretty)
+  assert_equal JSON.pretty_generate(obj), JSON.reformat(pretty)
+  assert_equal JSON.pretty_generate(obj, indent: "\t"), JSON.reformat(pretty, indent: "\t")
+  assert_equal JSON.minify(pretty), JSON.reformat(pretty, indent: 0)
+  assert_equal '"\\\\"', JSON.reformat(' "\\\\" ')
+  assert_raise(JSON::ParserError) { JSON.reformat('{"a":}') }
+  ps = JSON::PaddedString.new(pretty)
+  view = JSON::PaddedStringView.new(ps)
+  assert_equal ps, ps.minify!
+  assert_equal JSON.minify(pretty).bytesize, ps.bytesize
+  assert_equal obj, JSON::Document.new(JSON::PaddedStringView.new(ps)).at_pointer("")
+  assert_equal obj, JSON::Document.new(view).at_pointer("")
+end
+
+assert("JSON.reformat - scalars next to whitespace, empty containers and big integers") do
+  assert_equal "42", JSON.reformat("  42 \n")
+  assert_equal '"a , ] b"', JSON.reformat(" \"a , ] b\"\t")
+  assert_equal "[\n  {},\n  [],\n  -0.5e3\n]", JSON.reformat(" [ { } , [\n] , -0.5e3 ]")
+  big = "{ \"k\\\"ey\" : 123456789012345678901234567890 , \"a\": [ 18446744073709551616 ,1 ] }"
+  assert_equal "{\n  \"k\\\"ey\": 123456789012345678901234567890,\n  \"a\": [\n    18446744073709551616,\n    1\n  ]\n}", JSON.reformat(big)
+  assert_equal '{"k\\"ey":123456789012345678901234567890,"a":[18446744073709551616,1]}', JSON.reformat(big, indent: 0)
+  assert_equal "123456789012345678901234567890", JSON.reformat(" 123456789012345678901234567890 ")
+end
+
+assert("JSON.implementations / JSON.implementation=") do
+  impls = JSON.implementations
+  active = JSON.implementation
+  assert_include impls, active
+  other = impls.find { |i| i != active } || active
+  begin
+    assert_equal other, (JSON.implementation = other)
+    assert_equal other, JSON.implementation
+    assert_equal({"a" => [1, "é"]}, JSON.parse('{"a":[1,"é"]}'))
+    assert_true JSON.valid_utf8?("héllo")
+    assert_false JSON.valid_utf8?("\xff")
+  ensure
+    JSON.implementation = active
+  end
+  assert_equal active, JSON.implementation
+  assert_raise(ArgumentError) { JSON.implementation = "no-such-kernel" }
+end